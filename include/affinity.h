@@ -0,0 +1,24 @@
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <stdbool.h>
+
+// Ubicación de los hilos de trabajo (--pin, --cpus) y cantidad por defecto.
+//
+// cpus: lista tipo "0-7,16-23" (NULL = la afinidad actual del proceso); el
+// proceso entero queda limitado a esas CPUs. pin (o cpus != NULL): cada hilo
+// de trabajo se fija a una CPU libre de la lista mientras procesa un archivo,
+// así sus buffers (reservados y escritos por él: first-touch) quedan en la
+// memoria del nodo NUMA de esa CPU. Llamar antes de crear hilos.
+int affinity_init(const char *cpus, bool pin);
+
+// Hilos por defecto: CPUs de la máscara de afinidad (o de --cpus), limitadas
+// por la cuota de CPU del cgroup (cpu.max en v2, cfs_quota_us en v1).
+int affinity_default_threads(void);
+
+// Fija el hilo actual a una CPU libre. Devuelve el slot a liberar con
+// affinity_release, o -1 si no hay pinning (o no quedan CPUs libres).
+int affinity_claim(void);
+void affinity_release(int slot);
+
+#endif
@@ -2,17 +2,89 @@
 #define ALGORITHMS_H
 
 #include <stddef.h>
+#include <stdint.h>
+
+#include "algorithms/feistel.h"
+
+// Algoritmos de compresión disponibles (-a). El id se guarda en la cabecera
+// del archivo comprimido, así la descompresión sabe qué decodificador usar.
+typedef enum {
+    ALG_LZW = 1,
+    ALG_RLE = 2,
+    ALG_LZSS = 3,
+    ALG_HUFFMAN = 4
+} CompressionAlgorithm;
+
+#define ALG_LZSS_DEFAULT_LEVEL   6
+#define ALG_LZSS_MIN_WINDOW_BITS 10
+#define ALG_LZSS_MAX_WINDOW_BITS 16
+
+#define ALG_DICT_DEFAULT_SIZE (32 * 1024)
+#define ALG_DICT_MIN_SIZE     256
+// LZSS solo ve la ventana (64 KiB) y LZW llena la tabla antes: más no sirve
+#define ALG_DICT_MAX_SIZE     (1 << ALG_LZSS_MAX_WINDOW_BITS)
+
+// Diccionario entrenado (--train / -D). El id va en la cabecera de cada
+// archivo comprimido con él; descomprimir exige el mismo diccionario.
+typedef struct {
+    uint32_t id;
+    unsigned char *data;
+    size_t len;
+} CompressDict;
+
+// Parámetros de compresión (se comparten entre hilos, solo lectura)
+typedef struct {
+    CompressionAlgorithm algorithm;
+    int level;        // LZSS: 1..4 greedy, 5..9 lazy (0 -> default)
+    int window_bits;  // LZSS: ventana de 2^bits bytes (0 -> máximo)
+    const CompressDict *dict; // LZW / LZSS: diccionario entrenado (puede ser NULL)
+    int seekable;     // tramas independientes + índice final (--seekable, --range)
+    int nested;       // Huffman sobre la salida de -m c / h: se marca en la cabecera
+} CompressOptions;
 
 // API usada por el executor
 // Devuelven 0 en éxito, >0 en error
 
-// Compresión / descompresión (elige LZW por defecto; puedes forzar RLE con env GSEA_COMP=RLE)
-int alg_compress_copy(const char *in_path, const char *out_path);
-int alg_decompress_copy(const char *in_path, const char *out_path);
+// Compresión / descompresión. opts == NULL -> LZW con parámetros por defecto.
+// La descompresión lee el algoritmo de la cabecera; los archivos antiguos sin
+// cabecera se intentan con opts->algorithm y luego LZW / RLE.
+int alg_compress_copy(const char *in_path, const char *out_path, const CompressOptions *opts);
+int alg_decompress_copy(const char *in_path, const char *out_path, const CompressOptions *opts);
+
+// Etapa de entropía (-m ...h): Huffman canónico sobre el archivo, normalmente
+// la salida de otro compresor. nested != 0 (la op anterior fue c o h) lo
+// marca en la cabecera y alg_decompress_copy deshace ambas capas; sin la
+// marca la entrada vuelve tal cual, aunque parezca un contenedor.
+int alg_huffman_copy(const char *in_path, const char *out_path, int nested);
 
-// Encriptación / desencriptación con Feistel-16 (CBC, IV antepuesto)
+// Encriptación / desencriptación con Feistel-16 (CBC; cabecera con KCV e IV antepuesta)
 int alg_encrypt_copy(const char *in_path, const char *out_path, const char *key);
 int alg_decrypt_copy(const char *in_path, const char *out_path, const char *key);
+// Igual, con la clave ya derivada (feistel_init): sin repetir el key schedule
+int alg_encrypt_copy_key(const char *in_path, const char *out_path, const FeistelKey *fk);
+int alg_decrypt_copy_key(const char *in_path, const char *out_path, const FeistelKey *fk);
+
+// -m ce / -m ud en una sola pasada: cada trama de la entrada se comprime y
+// su salida se encripta enseguida (o al revés), mientras sigue en caché y
+// sin temporal intermedio. El formato es el mismo que con los pasos por
+// separado. mid_len (puede ser NULL) recibe el tamaño del paso intermedio.
+int alg_compress_encrypt_copy(const char *in_path, const char *out_path, const CompressOptions *opts, const FeistelKey *fk, uint64_t *mid_len);
+int alg_decrypt_decompress_copy(const char *in_path, const char *out_path, const CompressOptions *opts, const FeistelKey *fk, uint64_t *mid_len);
+
+// Extrae [start, start + len) del contenido original y lo escribe en out_fd
+// (--range). fk != NULL: la entrada está encriptada; decompress: además está
+// comprimida. Con un contenedor --seekable solo se leen y decodifican las
+// tramas que cubren el rango; len se recorta al final del contenido.
+int alg_extract_range(const char *in_path, int out_fd, int decompress, const FeistelKey *fk, const CompressOptions *opts, uint64_t start, uint64_t len);
+
+// Diccionarios: entrena uno a partir de una muestra de los archivos de
+// input_dir y lo guarda en dict_path; carga / libera uno existente.
+int alg_train_dictionary(const char *input_dir, const char *dict_path, size_t dict_size);
+int alg_dict_load(const char *path, CompressDict *dict);
+void alg_dict_free(CompressDict *dict);
+
+// Nombre de algoritmo ("lzw", "rle", "lzss", "huffman") -> id. Devuelve 0 si no existe.
+CompressionAlgorithm alg_parse_algorithm(const char *name);
 
 // Funciones directas si quieres invocarlas (no necesarias para executor)
 int alg_compress_rle_buf(const unsigned char *in, size_t in_len, unsigned char **out, size_t *out_len);
@@ -20,5 +92,18 @@ int alg_decompress_rle_buf(const unsigned char *in, size_t in_len, unsigned char
 
 int alg_compress_lzw_buf(const unsigned char *in, size_t in_len, unsigned char **out, size_t *out_len);
 int alg_decompress_lzw_buf(const unsigned char *in, size_t in_len, unsigned char **out, size_t *out_len);
+// LZW con la tabla pre-cargada con un diccionario entrenado
+int alg_compress_lzw_dict_buf(const unsigned char *dict, size_t dict_len, const unsigned char *in, size_t in_len, unsigned char **out, size_t *out_len);
+int alg_decompress_lzw_dict_buf(const unsigned char *dict, size_t dict_len, const unsigned char *in, size_t in_len, unsigned char **out, size_t *out_len);
+
+// LZSS: la descompresión necesita el tamaño original (viene en la cabecera).
+// dict puede ser NULL; si no, actúa como historia previa a la entrada.
+size_t alg_lzss_bound(size_t in_len);
+int alg_compress_lzss_buf(const unsigned char *dict, size_t dict_len, const unsigned char *in, size_t in_len, int level, int window_bits, unsigned char **out, size_t *out_len);
+int alg_decompress_lzss_buf(const unsigned char *dict, size_t dict_len, const unsigned char *in, size_t in_len, size_t raw_len, unsigned char **out, size_t *out_len);
+
+// Huffman canónico (códigos de hasta 11 bits, decodificación por tabla de 2 símbolos)
+int alg_compress_huffman_buf(const unsigned char *in, size_t in_len, unsigned char **out, size_t *out_len);
+int alg_decompress_huffman_buf(const unsigned char *in, size_t in_len, size_t raw_len, unsigned char **out, size_t *out_len);
 
-#endif
\ No newline at end of file
+#endif
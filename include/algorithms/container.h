@@ -0,0 +1,78 @@
+#ifndef ALGORITHMS_CONTAINER_H
+#define ALGORITHMS_CONTAINER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../algorithms.h"
+
+// Cabecera del contenedor comprimido (12 o 16 bytes):
+//   "GSZ" | id de algoritmo (1 byte) | tamaño original (u64 LE)
+//   [id de diccionario (u32 LE)] si GSZ_FLAG_DICT está en el byte de id
+// GSZ_FLAG_NESTED (solo Huffman, -m ...ch): el contenido descomprimido es a
+// su vez un contenedor y se descomprime también. Sin la marca nunca se mira
+// el contenido: un archivo que empieza con "GSZ" vuelve tal cual.
+// Si el tamaño original es GSZ_RAW_FRAMED el contenido va en tramas
+// independientes (modo streaming):
+//   [tamaño original u32 LE][tamaño comprimido u32 LE][datos] ...
+//   terminadas por una trama 0/0. Un hueco de un archivo disperso se guarda
+//   como [0 u32][GSZ_FRAME_HOLE u32][longitud u64 LE] sin datos.
+#define GSZ_HEADER_LEN       12
+#define GSZ_HEADER_MAX_LEN   16
+#define GSZ_FLAG_DICT        0x80
+#define GSZ_FLAG_NESTED      0x40
+#define GSZ_RAW_FRAMED       UINT64_MAX
+#define GSZ_FRAME_HEADER_LEN 8
+#define GSZ_FRAME_MAX_RAW    (64u * 1024 * 1024)
+#define GSZ_FRAME_HOLE       0xFFFFFFFFu
+#define GSZ_HOLE_FRAME_LEN   16
+
+// Índice para acceso aleatorio (--seekable): tras la trama final van las
+// entradas [offset original u64 LE][offset de la trama en el contenedor u64 LE],
+// una por trama (también las de hueco), y un trailer fijo:
+//   [offset del índice u64 LE][tamaño original total u64 LE][nro de entradas u32 LE]["GSZI"]
+// Los lectores sin soporte lo ignoran (todo lo que sigue a la trama final).
+#define GSZ_INDEX_ENTRY_LEN   16
+#define GSZ_INDEX_TRAILER_LEN 24
+#define GSZ_INDEX_MAGIC       "GSZI"
+
+// Escribe la cabecera y devuelve su longitud. dict puede ser NULL.
+// nested: marca GSZ_FLAG_NESTED (solo se admite con ALG_HUFFMAN).
+size_t gsz_write_header(unsigned char hdr[GSZ_HEADER_MAX_LEN], CompressionAlgorithm alg, uint64_t raw_len, const CompressDict *dict, int nested);
+
+// Devuelve la longitud de la cabecera si 'in' empieza con una válida, 0 si no.
+// nested (puede ser NULL) recibe la marca GSZ_FLAG_NESTED.
+size_t gsz_read_header(const unsigned char *in, size_t in_len, CompressionAlgorithm *alg, uint64_t *raw_len, uint32_t *dict_id, int *nested);
+
+// Diccionario a usar para el algoritmo (solo LZW / LZSS lo usan), o NULL.
+const CompressDict *gsz_dict_for(const CompressOptions *opts);
+
+// Comprime / descomprime un bloque (sin cabecera) con el algoritmo indicado.
+int gsz_encode_block(const CompressOptions *opts, const unsigned char *in, size_t in_len, unsigned char **out, size_t *out_len);
+int gsz_decode_block(CompressionAlgorithm alg, const CompressDict *dict, const unsigned char *in, size_t in_len, size_t raw_len, unsigned char **out, size_t *out_len);
+
+// Verifica que el diccionario recibido coincide con el id de la cabecera.
+// Devuelve el diccionario a usar (NULL si no hace falta) en *use. 0 si ok.
+int gsz_check_dict(uint32_t dict_id, const CompressDict *dict, const CompressDict **use);
+
+// Codificación por tramas de un bloque único (LZW y RLE): el estado pasa de
+// una trama a la siguiente, así el resultado es idéntico al de
+// gsz_encode_block / gsz_decode_block sin tener el bloque entero en memoria.
+// La salida se entrega a 'emit' de a trozos de hasta ~GSZ_TILE_LEN bytes.
+#define GSZ_TILE_LEN (256 * 1024)   // cabe en la L2: se comprime y se encripta sin salir de caché
+typedef struct GszTileCoder GszTileCoder;
+typedef int (*GszTileEmit)(void *ctx, const unsigned char *buf, size_t len);
+
+int gsz_tile_supported(CompressionAlgorithm alg);
+// NULL si el algoritmo no tiene modo por tramas o falla la memoria
+GszTileCoder *gsz_tile_encoder_new(const CompressOptions *opts);
+GszTileCoder *gsz_tile_decoder_new(CompressionAlgorithm alg, const CompressDict *dict);
+int gsz_tile_push(GszTileCoder *tc, const unsigned char *in, size_t len, GszTileEmit emit, void *ctx);
+int gsz_tile_finish(GszTileCoder *tc, GszTileEmit emit, void *ctx);
+uint64_t gsz_tile_total(const GszTileCoder *tc);   // bytes entregados
+void gsz_tile_free(GszTileCoder *tc);
+
+// Archivos antiguos sin cabecera: prueba el algoritmo elegido, LZW y RLE.
+int gsz_decode_legacy(const unsigned char *in, size_t in_len, const CompressOptions *opts, unsigned char **out, size_t *out_len);
+
+#endif
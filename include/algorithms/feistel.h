@@ -0,0 +1,55 @@
+#ifndef ALGORITHMS_FEISTEL_H
+#define ALGORITHMS_FEISTEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Contexto con las 16 subclaves ya derivadas (se puede reutilizar y
+// compartir entre hilos: solo lectura una vez inicializado).
+typedef struct {
+    uint32_t round_keys[16];
+} FeistelKey;
+
+void feistel_init(FeistelKey *fk, const unsigned char *key, size_t key_len);
+
+// IV aleatorio de 8 bytes (/dev/urandom). 0 en éxito.
+int feistel_random_iv(uint8_t iv[8]);
+
+// CBC sobre bloques completos (len múltiplo de 8). 'iv' entra con el bloque
+// anterior y sale con el último bloque cifrado, para encadenar llamadas.
+// in y out pueden ser el mismo buffer.
+void feistel_cbc_encrypt(const FeistelKey *fk, uint8_t iv[8], const unsigned char *in, unsigned char *out, size_t len);
+void feistel_cbc_decrypt(const FeistelKey *fk, uint8_t iv[8], const unsigned char *in, unsigned char *out, size_t len);
+
+// Valida el padding PKCS#7 del último bloque descifrado. 0 si es válido.
+int feistel_unpad(const unsigned char *last_block, size_t *pad_len);
+
+// Cabecera del texto cifrado: "GSE" | versión (1) | KCV (4) | IV (8).
+// El KCV (key-check value) son 4 bytes de E_k(IV xor "GSEA-KCV"): con una
+// clave incorrecta el descifrado falla con un solo bloque, antes de leer o
+// descifrar el resto. Los archivos anteriores empiezan directo con el IV y
+// se siguen aceptando (sin esa comprobación anticipada).
+#define FEISTEL_HEADER_LEN 16
+#define FEISTEL_LEGACY_HEADER_LEN 8
+#define FEISTEL_KCV_LEN 4
+
+// Escribe la cabecera para ese IV en out[0 .. FEISTEL_HEADER_LEN)
+void feistel_write_header(const FeistelKey *fk, const uint8_t iv[8], unsigned char out[FEISTEL_HEADER_LEN]);
+
+// Lee la cabecera de in[0 .. len) (len >= FEISTEL_HEADER_LEN, o todo el
+// archivo si es más corto): copia el IV y deja en *header_len dónde empieza
+// el primer bloque cifrado (FEISTEL_HEADER_LEN, o 8 en formato antiguo).
+// 1 si el KCV no coincide (clave incorrecta) o la cabecera está truncada.
+int feistel_read_header(const FeistelKey *fk, const unsigned char *in, size_t len, uint8_t iv[8], size_t *header_len);
+
+// Cifrado / descifrado completo (cabecera + CBC + PKCS#7) en el lugar, sin copias.
+// encrypt: buf = [FEISTEL_HEADROOM libres][len bytes de texto][FEISTEL_TAILROOM
+// libres]; al volver buf[0 .. *out_len) es cabecera + texto cifrado.
+// decrypt: buf[0 .. len) = cabecera + texto cifrado; al volver el texto plano
+// queda en buf + *plain_off con *plain_len bytes (el padding solo se descuenta).
+#define FEISTEL_HEADROOM FEISTEL_HEADER_LEN
+#define FEISTEL_TAILROOM 8
+int feistel_encrypt_inplace(const FeistelKey *fk, unsigned char *buf, size_t len, size_t *out_len);
+int feistel_decrypt_inplace(const FeistelKey *fk, unsigned char *buf, size_t len, size_t *plain_off, size_t *plain_len);
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef ALGORITHMS_KERNELS_H
+#define ALGORITHMS_KERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Núcleos calientes compilados en varias variantes de ISA (escalar, SSE4.2,
+// AVX2, AVX-512). La variante se elige una sola vez, la primera vez que se
+// llama a kernels(), según cpuid; GSEA_ISA=scalar|sse4.2|avx2|avx512 la
+// fuerza (para pruebas; nunca por encima de lo que soporta la CPU).
+
+// Función de ronda de Feistel (compartida por el cifrado y los núcleos)
+static inline uint32_t feistel_round_f(uint32_t half, uint32_t rk) {
+    uint32_t x = half + rk;
+    x ^= (half << 5) | (half >> 27);
+    x += rk ^ 0xA5A5A5A5u;
+    x = (x << 11) | (x >> 21);
+    x ^= rk >> 3;
+    return x;
+}
+
+typedef struct {
+    const char *name;
+    // Cantidad de bytes iguales a p[0] al comienzo de p[0..n) (n >= 1)
+    size_t (*run_length)(const unsigned char *p, size_t n);
+    // dst = a ^ b (dst puede ser a o b)
+    void (*xor_bytes)(unsigned char *dst, const unsigned char *a, const unsigned char *b, size_t len);
+    // Descifra nblocks bloques de 8 bytes independientes (sin CBC); in != out
+    void (*feistel_decrypt_blocks)(const uint32_t round_keys[16], const unsigned char *in, unsigned char *out, size_t nblocks);
+} Kernels;
+
+const Kernels *kernels(void);
+
+// Para el benchmark: variantes que esta CPU puede ejecutar (0 = escalar)
+int kernels_variant_count(void);
+const Kernels *kernels_variant(int i);
+
+#endif
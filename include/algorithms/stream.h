@@ -0,0 +1,60 @@
+#ifndef ALGORITHMS_STREAM_H
+#define ALGORITHMS_STREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../algorithms.h"
+
+// Etapas de procesamiento por trozos (modo streaming, -i - / -o -).
+// Cada etapa recibe datos con stream_push, los transforma con memoria
+// acotada y entrega el resultado a la siguiente etapa o a un sink.
+typedef struct StreamStage StreamStage;
+
+// Destino final: devuelve 0 en éxito
+typedef int (*StreamSink)(void *ctx, const unsigned char *buf, size_t len);
+// Destino opcional para huecos (len bytes en cero que deben quedar como
+// hueco). Sin él, los huecos se entregan al sink como ceros.
+typedef int (*StreamHoleSink)(void *ctx, uint64_t len);
+
+#define STREAM_BLOCK_SIZE (1024 * 1024)   // tamaño de trama al comprimir
+#define STREAM_CHUNK      (64 * 1024)     // lecturas / escrituras de E/S
+
+// Constructores. NULL si falla la memoria (o falta la clave).
+StreamStage *stream_compress_new(const CompressOptions *opts, size_t block_size);
+StreamStage *stream_decompress_new(const CompressOptions *opts);
+StreamStage *stream_encrypt_new(const char *key);
+StreamStage *stream_decrypt_new(const char *key);
+// Igual, con la clave ya derivada (feistel_init)
+StreamStage *stream_encrypt_new_key(const FeistelKey *fk);
+StreamStage *stream_decrypt_new_key(const FeistelKey *fk);
+
+// Conecta la salida de 'st' a otra etapa o a un sink
+void stream_set_next(StreamStage *st, StreamStage *next);
+void stream_set_sink(StreamStage *st, StreamSink sink, void *ctx);
+void stream_set_hole_sink(StreamStage *st, StreamHoleSink hole);
+
+// Devuelven 0 en éxito, 1 en error. stream_finish vacía lo pendiente y
+// termina también las etapas siguientes.
+int stream_push(StreamStage *st, const unsigned char *buf, size_t len);
+// len bytes en cero que vienen de un hueco: la compresión los guarda como
+// trama de hueco; el resto de etapas los procesa como ceros.
+int stream_push_hole(StreamStage *st, uint64_t len);
+int stream_finish(StreamStage *st);
+
+// Bytes entregados hasta ahora por la etapa (huecos incluidos)
+uint64_t stream_bytes_out(const StreamStage *st);
+
+// Libera la etapa y todas las siguientes
+void stream_free(StreamStage *st);
+
+// Sink que escribe en un descriptor (ctx apunta a un int con el fd) y su
+// versión para huecos (lseek; al terminar usar fd_finish_sparse)
+int stream_fd_sink(void *ctx, const unsigned char *buf, size_t len);
+int stream_fd_hole_sink(void *ctx, uint64_t len);
+
+// Lee 'in_fd' hasta EOF empujando a 'head' y luego llama stream_finish.
+// Si in_fd es un archivo disperso, los huecos se empujan sin leerlos.
+int stream_run_fd(StreamStage *head, int in_fd);
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include <semaphore.h>
+#include <stdint.h>
+
+// Control adaptativo de la cantidad de hilos (-t auto).
+//
+// Un hilo propio mide en ventanas de ~0,5 s los bytes procesados por segundo (métricas)
+// y ajusta los permisos del semáforo que limita los hilos de trabajo
+// (hill-climbing): si el último cambio mejoró el rendimiento sigue en esa
+// dirección, si lo empeoró vuelve atrás con un paso menor. Con rendimiento
+// parejo decide por las esperas: CPUs saturadas -> menos hilos; hilos
+// esperando E/S y el despachador esperando permisos -> más hilos.
+typedef struct AutoTune AutoTune;
+
+// limiter ya inicializado con 'initial' permisos; el límite se mueve en
+// [1, max]. NULL si no se pudo crear el hilo (queda fijo en 'initial').
+AutoTune *autotune_start(sem_t *limiter, int initial, int max);
+
+// Tiempo que el despachador esperó un permiso (sem_wait)
+void autotune_dispatch_wait(AutoTune *at, uint64_t usec);
+
+// Llamar tras cada sem_wait del despachador: 1 si ese permiso se retiene
+// para achicar el límite (volver a esperar), 0 si se puede usar.
+int autotune_absorb(AutoTune *at);
+
+// Detiene el controlador (los permisos que retuvo ya no hacen falta)
+void autotune_stop(AutoTune *at);
+
+#endif
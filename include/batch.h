@@ -0,0 +1,58 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Lista de archivos a procesar y reparto entre nodos (--files-from, --shard).
+
+typedef struct {
+    unsigned shard_index;       // --shard i/N: este nodo procesa el shard i (0..N-1)
+    unsigned shard_count;       // 0 = sin reparto (todo)
+    const char *summary_path;   // --summary: resumen de este shard (NULL = no)
+} BatchOptions;
+
+#define BATCH_SIZE_UNKNOWN UINT64_MAX
+
+typedef struct {
+    char *in;        // ruta de entrada
+    char *rel;       // ruta relativa dentro del directorio de salida
+    uint64_t size;   // tamaño declarado en la lista (BATCH_SIZE_UNKNOWN si no)
+    int result;      // 0 ok, 1 error, -1 sin procesar
+} BatchFile;
+
+typedef struct {
+    BatchFile *files;
+    size_t count, cap;
+} BatchList;
+
+// "i/N" con 0 <= i < N. 0 en éxito.
+int batch_parse_shard(const char *s, BatchOptions *batch);
+
+// Archivos regulares de un directorio (sin recursión); rel = nombre.
+int batch_list_from_directory(BatchList *list, const char *dir);
+
+// Lista de rutas separadas por '\n' o por '\0' (se detecta: si hay algún
+// NUL, se separa por NUL). "-" = stdin. rel = ruta sin '/' ni "./" iniciales;
+// las rutas con ".." se rechazan. Cada entrada puede llevar delante el
+// tamaño: "tamaño<TAB>ruta" (para --shard; una ruta que empiece así se
+// escribe con "./" delante).
+int batch_list_from_file(BatchList *list, const char *list_path);
+
+// Deja en la lista solo los archivos del shard index/count. El reparto
+// depende solo de la lista (mismo resultado en todos los nodos, sin stat):
+// si todas las entradas traen tamaño, de mayor a menor cada archivo va al
+// shard con menos bytes; si no, por hash de la ruta relativa.
+int batch_shard(BatchList *list, unsigned index, unsigned count);
+
+void batch_list_free(BatchList *list);
+
+// Resumen del shard en texto "clave valor" (ver README). Los contadores se
+// suman al combinar; los fallidos se listan con "fail <ruta>".
+int batch_write_summary(const BatchOptions *batch, const BatchList *list, const char *output_dir, uint64_t elapsed_usec);
+
+// --merge-summaries: combina resúmenes (también ya combinados) y escribe el
+// resultado en stdout; avisa en stderr si faltan shards o hay repetidos.
+int batch_merge_summaries(int count, char **paths);
+
+#endif
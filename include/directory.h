@@ -6,4 +6,8 @@
 bool is_directory(const char *path);
 void list_directory(const char *path);
 
+// Crea los directorios que faltan en la ruta de 'path' (sin el último
+// componente), como mkdir -p. 0 en éxito.
+int make_parent_dirs(const char *path);
+
 #endif
\ No newline at end of file
@@ -2,13 +2,34 @@
 #define EXECUTOR_H
 
 #include "pipeline.h"
+#include "batch.h"
+
+// "ce" -> {OP_COMPRESS, OP_ENCRYPT} (máximo 4 operaciones). 0 en éxito.
+int parse_sequence(const char *s, OperationType *out, size_t *out_len);
 
 // Procesa un único archivo (secuencial o en hilo)
 void *process_file_pipeline(void *arg);
 
+// -t auto: empieza con las CPUs disponibles y el controlador (autotune.h)
+// mueve el límite entre 1 y max(CPUs * FACTOR, MIN_MAX) según el rendimiento.
+#define EXECUTOR_THREADS_AUTO    (-1)
+#define EXECUTOR_AUTO_MAX_FACTOR 16
+#define EXECUTOR_AUTO_MIN_MAX    64
+
 // Recorre un directorio y crea un hilo por cada archivo regular.
-// max_threads: número máximo de hilos simultáneos (si 0 -> sysconf(_SC_NPROCESSORS_ONLN)).
-int process_directory_concurrently(const char *input_dir, const char *output_dir, OperationType *op_sequence, size_t seq_len, int max_threads, char *key);
+// max_threads: número máximo de hilos simultáneos (0 -> CPUs disponibles,
+// ver affinity_default_threads; EXECUTOR_THREADS_AUTO -> ajuste automático).
+// batch (puede ser NULL): --shard y --summary.
+int process_directory_concurrently(const char *input_dir, const char *output_dir, OperationType *op_sequence, size_t seq_len, int max_threads, char *key, const CompressOptions *comp, const BatchOptions *batch);
+
+// Igual, pero con los archivos de una lista (--files-from; "-" = stdin).
+// Cada salida va a output_dir/<ruta relativa>, creando los subdirectorios.
+int process_file_list(const char *list_path, const char *output_dir, OperationType *op_sequence, size_t seq_len, int max_threads, char *key, const CompressOptions *comp, const BatchOptions *batch);
+
+// Modo streaming (-i - / -o -): encadena las operaciones en memoria, sin
+// archivos temporales y con buffers acotados. in_fd / out_fd pueden ser
+// stdin / stdout o archivos ya abiertos.
+int process_stream_pipeline(int in_fd, int out_fd, OperationType *op_sequence, size_t seq_len, char *key, const CompressOptions *comp);
 
 #endif
 
@@ -6,6 +6,7 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 // Abre un archivo. 'flags' es como O_RDONLY, O_WRONLY, etc.
 int safe_open(const char *path, int flags, mode_t mode);
@@ -14,6 +15,9 @@ int safe_open(const char *path, int flags, mode_t mode);
 // Devuelve cantidad leída, o -1 si error.
 ssize_t safe_read(int fd, void *buffer, size_t n);
 
+// Igual que safe_read pero desde 'offset', sin mover el offset de fd.
+ssize_t safe_pread(int fd, void *buffer, size_t n, uint64_t offset);
+
 // Escribe EXACTAMENTE n bytes, aunque write() escriba menos.
 // Devuelve 0 si ok, -1 si error.
 int safe_write(int fd, const void *buffer, size_t n);
@@ -21,7 +25,79 @@ int safe_write(int fd, const void *buffer, size_t n);
 // Cierra un archivo.
 int safe_close(int fd);
 
+// Límites de E/S para safe_read / safe_write, globales a todos los hilos
+// (token bucket). MB = 10^6 bytes; 0 = sin límite. Llamar antes de crear hilos.
+int io_throttle_set(double read_mbps, double write_mbps, double iops);
+
+// Clase de E/S "idle" (ioprio_set): el disco solo atiende a gsea cuando nadie
+// más lo usa. La heredan los hilos creados después.
+int io_set_idle_priority(void);
+
 // Carga un archivo COMPLETO en memoria (malloc).
 unsigned char *read_file_complete(const char *path, size_t *size_out);
 
+// Igual, pero reserva 'head' bytes libres antes del contenido y 'tail'
+// después (el archivo queda en buffer + head), para transformar en el lugar.
+unsigned char *read_file_headroom(const char *path, size_t head, size_t tail, size_t *size_out);
+
+// Igual, desde un fd ya abierto (posicionado al inicio); no lo cierra.
+unsigned char *read_fd_headroom(int fd, size_t head, size_t tail, size_t *size_out);
+
+// Archivos dispersos (sparse), vía lseek(SEEK_DATA / SEEK_HOLE).
+// true si fd es un archivo regular con al menos un hueco.
+bool fd_is_sparse(int fd);
+
+// Siguiente tramo con datos a partir de pos: [*data_start, *data_end).
+// Deja el offset de fd en *data_start. 0 ok, 1 no hay más datos, -1 error.
+int fd_next_extent(int fd, off_t pos, off_t size, off_t *data_start, off_t *data_end);
+
+// Avanza len bytes sin escribir (crea un hueco); en pipes escribe ceros.
+int fd_skip_hole(int fd, uint64_t len);
+
+// Si la escritura terminó en un hueco, fija el tamaño final con ftruncate.
+int fd_finish_sparse(int fd);
+
+// Salidas atómicas: se escribe en un archivo sin nombre (O_TMPFILE) o con
+// nombre oculto ".<nombre>.gsea-XXXXXX" en el mismo directorio, y recién al
+// terminar bien se publica con linkat / rename. Un fallo o una caída nunca
+// deja un archivo truncado con el nombre final. Las rutas que existen y no
+// son archivos regulares (/dev/null, fifos) se abren directo, como antes.
+typedef enum {
+    DURABILITY_NONE = 0,   // sin fsync (default)
+    DURABILITY_FILE,       // fsync del archivo y del directorio por cada salida
+    DURABILITY_BATCH       // un syncfs por sistema de archivos al final (io_output_flush)
+} Durability;
+
+typedef struct {
+    int fd;
+    char *path;        // ruta final
+    char *tmp_path;    // nombre oculto (NULL si es O_TMPFILE o directo)
+    bool direct;       // abierta directo sobre la ruta final
+} OutputFile;
+
+// "none" | "file" | "batch". 0 en éxito.
+int io_parse_durability(const char *s, Durability *out);
+
+// Fija la durabilidad y lee la umask; llamar antes de crear hilos.
+void io_output_init(Durability durability);
+
+// DURABILITY_BATCH: syncfs de cada sistema de archivos donde se publicó algo.
+// Sin nada pendiente (u otro modo) no hace nada. Al volver, toda salida
+// publicada antes de la llamada está en disco (aunque otro hilo la sincronizó).
+int io_output_flush(void);
+
+// Marca las salidas de este hilo como temporales intermedios (sin
+// publicación atómica ni fsync) hasta volver a llamarla con false.
+void io_output_scratch(bool on);
+
+// size_hint > 0: tamaño final conocido, se reserva con fallocate.
+int output_open(OutputFile *of, const char *path, uint64_t size_hint);
+// Publica la salida (y la cierra). 0 en éxito; si falla no queda nada.
+int output_commit(OutputFile *of);
+// Descarta la salida.
+void output_abort(OutputFile *of);
+
+// Socket Unix en escucha en 'path' (borra uno anterior, permisos 0600). -1 en error.
+int unix_socket_listen(const char *path);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,43 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+
+#include "pipeline.h"
+
+// Métricas del proceso: contadores por hilo (sin contención en el camino
+// caliente) que se suman solo al leerlos.
+// - SIGUSR1 imprime un resumen en stderr (progreso, MB/s, archivos en curso)
+// - con socket_path, cada conexión a ese socket Unix recibe las métricas en
+//   formato de texto de Prometheus
+// Devuelven 0 en éxito, >0 en error
+
+// Llamar antes de crear hilos: bloquea SIGUSR1 para que lo atienda un hilo propio.
+int metrics_start(const char *socket_path);
+void metrics_stop(void);
+
+// Progreso del recorrido de directorio (hilo principal)
+void metrics_files_total(uint64_t n);
+void metrics_file_queued(void);
+
+// Ciclo de vida de un archivo dentro de su hilo
+void metrics_file_begin(const char *path);
+void metrics_file_end(int ok);
+
+// Una operación terminada: bytes leídos / escritos y duración
+void metrics_op_done(OperationType op, uint64_t bytes_in, uint64_t bytes_out, uint64_t usec);
+
+// Totales acumulados (para el control adaptativo de hilos, -t auto).
+// wall_usec: tiempo de los hilos sobre archivos terminados; cpu_usec: la parte
+// de ese tiempo en CPU (el resto es espera: disco, red, límites de E/S).
+typedef struct {
+    uint64_t files_done;   // terminados, con o sin error
+    uint64_t bytes_in;     // bytes leídos por todas las operaciones
+    uint64_t wall_usec, cpu_usec;
+} MetricsTotals;
+void metrics_totals(MetricsTotals *t);
+
+// Microsegundos de un reloj monótono (para medir operaciones)
+uint64_t metrics_now_usec(void);
+
+#endif
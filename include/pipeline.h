@@ -4,20 +4,26 @@
 #include <semaphore.h>
 #include <stddef.h>
 
+#include "algorithms.h"
+
 typedef enum {
     OP_NONE = 0,
     OP_COMPRESS,
     OP_DECOMPRESS,
     OP_ENCRYPT,
-    OP_DECRYPT
+    OP_DECRYPT,
+    OP_HUFFMAN
 } OperationType;
 
 typedef struct {
     char *input_file_path;   // se liberan dentro del thread
     char *output_file_path;  // ruta final o ruta temporal (no liberar si apunta a original de caller)
     char *key;               // puntero a clave (no duplicado)
+    const FeistelKey *fkey;  // clave ya derivada (si no es NULL se usa en lugar de key)
+    const CompressOptions *comp; // parámetros de compresión (no duplicado)
     OperationType sequence[4];
     sem_t *limiter;          // semáforo para limitar concurrencia (puede ser NULL)
+    int *result;             // si no es NULL recibe 0 (éxito) o 1 (error)
 } ThreadArgs;
 
 #endif
\ No newline at end of file
@@ -0,0 +1,20 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "algorithms.h"
+
+// Modo servicio (--serve <socket>): un pool de max_threads hilos (0 -> nro
+// CPUs) atiende trabajos que llegan por un socket Unix, sin pagar arranque
+// del proceso ni derivación de claves por archivo.
+//
+// Protocolo (texto, una línea por trabajo, campos separados por TAB):
+//   <ops>\t<entrada>\t<salida>[\t<id de clave>]\n
+// Respuesta por cada línea (pueden llegar en otro orden; n = número de
+// línea dentro de la conexión, desde 1):
+//   OK\t<n>\n   o   ERR\t<n>\t<mensaje>\n
+// "PING" responde "PONG". Las claves se derivan una sola vez al arrancar:
+// default_key (-k) con id "default" y las de keys_path (líneas id:clave).
+// SIGINT / SIGTERM: deja de aceptar, termina los trabajos pendientes y sale.
+int serve_unix_socket(const char *socket_path, int max_threads, const char *default_key, const char *keys_path, const CompressOptions *comp);
+
+#endif
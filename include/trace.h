@@ -0,0 +1,21 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+// Línea de tiempo por hilo (--trace out.json) en formato trace-event de
+// Chrome / Perfetto (chrome://tracing, ui.perfetto.dev).
+// Cada hilo guarda sus eventos en su propio buffer; todo se escribe al
+// final con trace_stop. Sin trace_start las funciones no hacen nada.
+// Devuelven 0 en éxito, >0 en error
+
+int trace_start(const char *path);
+int trace_stop(void);
+
+// Abre / cierra un tramo en el hilo actual (deben anidarse bien).
+// name debe ser un literal; detail (opcional) se copia, ej. la ruta del archivo.
+void trace_begin(const char *name, const char *detail);
+void trace_end(void);
+
+// El hilo terminó su archivo: su fila ("worker N") queda libre para otro hilo
+void trace_thread_done(void);
+
+#endif
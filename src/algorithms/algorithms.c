@@ -1,6 +1,11 @@
 #define _POSIX_C_SOURCE 200809L
 #include "../../include/algorithms.h"
 #include "../../include/file.h"
+#include "../../include/algorithms/feistel.h"
+#include "../../include/algorithms/container.h"
+#include "../../include/algorithms/stream.h"
+#include "../../include/algorithms/kernels.h"
+#include "../../include/trace.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -14,16 +19,31 @@
    Utilities: read whole file and write whole file (use existing helpers)
    ------------------------------------------------------- */
 
-/* helper to write buffer to path using safe_open / safe_write */
-static int write_buffer_to_file(const char *out_path, const unsigned char *buf, size_t len) {
-    int fd = safe_open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-    if (fd < 0) return 1;
-    if (safe_write(fd, buf, len) != 0) {
-        safe_close(fd);
-        return 1;
+/* read_file_complete with a trace span */
+static unsigned char *read_input(const char *in_path, size_t *len) {
+    trace_begin("read", NULL);
+    unsigned char *buf = read_file_complete(in_path, len);
+    trace_end();
+    return buf;
+}
+
+/* helper to write [hdr][buf] to path: preallocated, published atomically */
+static int write_buffers_to_file(const char *out_path, const unsigned char *hdr, size_t hdr_len, const unsigned char *buf, size_t len) {
+    trace_begin("write", NULL);
+    int rc = 1;
+    OutputFile of;
+    if (output_open(&of, out_path, (uint64_t)hdr_len + len) == 0) {
+        rc = (hdr_len > 0 && safe_write(of.fd, hdr, hdr_len) != 0) || safe_write(of.fd, buf, len) != 0;
+        if (rc == 0) rc = output_commit(&of);
+        else output_abort(&of);
     }
-    safe_close(fd);
-    return 0;
+    trace_end();
+    return rc;
+}
+
+/* same as above without a header */
+static int write_buffer_to_file(const char *out_path, const unsigned char *buf, size_t len) {
+    return write_buffers_to_file(out_path, NULL, 0, buf, len);
 }
 
 /* helper to read random bytes from /dev/urandom */
@@ -41,32 +61,52 @@ static int read_random_bytes(unsigned char *buf, size_t n) {
    count 1..255. If run >255, split.
    ======================================================= */
 
-int alg_compress_rle_buf(const unsigned char *in, size_t in_len, unsigned char **out, size_t *out_len) {
-    if (!in) return 1;
-    // Worst case: each byte becomes 2 bytes. Allocate 2*in_len
-    size_t cap = in_len == 0 ? 1 : in_len * 2;
-    unsigned char *res = malloc(cap);
-    if (!res) return 1;
-    size_t w = 0;
+/* pending run of the encoder (count 0 = none): a run may continue in the
+   next call, so encoding a file piece by piece gives the same pairs */
+typedef struct {
+    unsigned char val;
+    size_t count;
+} RLERun;
 
-    size_t i = 0;
-    while (i < in_len) {
-        unsigned char val = in[i];
-        unsigned int count = 1;
-        i++;
-        while (i < in_len && in[i] == val && count < 255) {
-            count++; i++;
+/* encodes in[0..len); at most 2 * len + 2 bytes go to out */
+static size_t rle_encode_run(RLERun *run, const unsigned char *in, size_t len, unsigned char *out) {
+    size_t w = 0, i = 0;
+    while (i < len) {
+        if (run->count > 0 && run->count < 255 && in[i] == run->val) {
+            size_t left = len - i, room = 255 - run->count;
+            size_t n = kernels()->run_length(in + i, left < room ? left : room);
+            run->count += n;
+            i += n;
+            continue;
         }
-        // write pair
-        if (w + 2 > cap) {
-            cap *= 2;
-            unsigned char *tmp = realloc(res, cap);
-            if (!tmp) { free(res); return 1; }
-            res = tmp;
+        if (run->count > 0) {
+            out[w++] = (unsigned char)run->count;
+            out[w++] = run->val;
         }
-        res[w++] = (unsigned char)count;
-        res[w++] = val;
+        size_t left = len - i;
+        run->val = in[i];
+        run->count = kernels()->run_length(in + i, left < 255 ? left : 255);
+        i += run->count;
     }
+    return w;
+}
+
+static size_t rle_encode_flush(RLERun *run, unsigned char *out) {
+    if (run->count == 0) return 0;
+    out[0] = (unsigned char)run->count;
+    out[1] = run->val;
+    run->count = 0;
+    return 2;
+}
+
+int alg_compress_rle_buf(const unsigned char *in, size_t in_len, unsigned char **out, size_t *out_len) {
+    if (!in) return 1;
+    // Worst case: each byte becomes 2 bytes
+    unsigned char *res = malloc(in_len * 2 + 2);
+    if (!res) return 1;
+    RLERun run = { 0, 0 };
+    size_t w = rle_encode_run(&run, in, in_len, res);
+    w += rle_encode_flush(&run, res + w);
 
     *out = res;
     *out_len = w;
@@ -82,7 +122,7 @@ int alg_decompress_rle_buf(const unsigned char *in, size_t in_len, unsigned char
     if (!res) return 1;
     size_t w = 0;
     size_t i = 0;
-    while (i + 1 <= in_len - 1) { // need at least two bytes
+    while (i + 1 < in_len) { // need at least two bytes
         unsigned char count = in[i++];
         unsigned char val = in[i++];
         if (w + (size_t)count > cap) {
@@ -91,7 +131,8 @@ int alg_decompress_rle_buf(const unsigned char *in, size_t in_len, unsigned char
             if (!tmp) { free(res); return 1; }
             res = tmp;
         }
-        for (unsigned int k = 0; k < count; ++k) res[w++] = val;
+        memset(res + w, val, count);
+        w += count;
     }
     // If odd number of bytes -> malformed RLE
     if (i != in_len) { free(res); return 1; }
@@ -109,137 +150,160 @@ int alg_decompress_rle_buf(const unsigned char *in, size_t in_len, unsigned char
    - decoder reads uint16_t codes
    This is NOT bit-packed and thus less space-efficient than classic LZW,
    but simple to implement and robust for academic use.
+   Entries are stored as (prefix code, last byte); the encoder finds
+   (w, k) with an open-addressing hash table. A trained dictionary can
+   pre-seed the table: both sides run the encoder over it first.
    ======================================================= */
 
+#define LZW_MAX_CODES  65536
+#define LZW_HASH_SIZE  (1u << 17)          /* 2x max codes, power of two */
+#define LZW_HASH_EMPTY 0xFFFFFFFFu
+
 typedef struct {
-    unsigned char *data;
-    size_t len;
-} LZWEntry;
-
-static int lzw_add_entry(LZWEntry **dict, size_t *dict_size, size_t *dict_cap, const unsigned char *data, size_t len) {
-    if (*dict_size >= *dict_cap) {
-        size_t nc = (*dict_cap == 0) ? 512 : (*dict_cap * 2);
-        LZWEntry *tmp = realloc(*dict, nc * sizeof(LZWEntry));
-        if (!tmp) return 1;
-        *dict = tmp;
-        *dict_cap = nc;
-    }
-    unsigned char *copy = malloc(len);
-    if (!copy) return 1;
-    memcpy(copy, data, len);
-    (*dict)[*dict_size].data = copy;
-    (*dict)[*dict_size].len = len;
-    (*dict_size)++;
-    return 0;
+    uint16_t prefix[LZW_MAX_CODES];
+    uint8_t  suffix[LZW_MAX_CODES];
+    uint8_t  first[LZW_MAX_CODES];      /* first byte of the string */
+    uint32_t length[LZW_MAX_CODES];     /* string length */
+    uint32_t hkey[LZW_HASH_SIZE];       /* (prefix << 8 | byte), LZW_HASH_EMPTY if free */
+    uint16_t hcode[LZW_HASH_SIZE];
+    size_t size;
+} LZWTable;
+
+static LZWTable *lzw_table_new(void) {
+    LZWTable *t = malloc(sizeof(LZWTable));
+    if (!t) return NULL;
+    for (int i = 0; i < 256; ++i) {
+        t->prefix[i] = 0;
+        t->suffix[i] = (uint8_t)i;
+        t->first[i] = (uint8_t)i;
+        t->length[i] = 1;
+    }
+    memset(t->hkey, 0xFF, sizeof(t->hkey));
+    t->size = 256;
+    return t;
+}
+
+static inline uint32_t lzw_slot(uint32_t key) {
+    return (key * 2654435761u) >> (32 - 17);
 }
 
-/* search dict for sequence data,len; returns index or -1 */
-static int lzw_find(LZWEntry *dict, size_t dict_size, const unsigned char *data, size_t len) {
-    for (size_t i = 0; i < dict_size; ++i) {
-        if (dict[i].len == len && memcmp(dict[i].data, data, len) == 0) return (int)i;
+/* code for string(w) + k, or -1 */
+static inline int lzw_lookup(const LZWTable *t, int w, unsigned char k) {
+    uint32_t key = ((uint32_t)w << 8) | k;
+    for (uint32_t h = lzw_slot(key); ; h = (h + 1) & (LZW_HASH_SIZE - 1)) {
+        if (t->hkey[h] == LZW_HASH_EMPTY) return -1;
+        if (t->hkey[h] == key) return t->hcode[h];
     }
-    return -1;
 }
 
-int alg_compress_lzw_buf(const unsigned char *in, size_t in_len, unsigned char **out, size_t *out_len) {
-    if (!in) return 1;
-    // initialize dict with single bytes
-    LZWEntry *dict = NULL;
-    size_t dict_size = 0, dict_cap = 0;
-    for (int i = 0; i < 256; ++i) {
-        unsigned char b = (unsigned char)i;
-        if (lzw_add_entry(&dict, &dict_size, &dict_cap, &b, 1) != 0) goto lzw_encode_fail;
+/* adds string(w) + k as the next code (no-op once the table is full) */
+static inline void lzw_add(LZWTable *t, int w, unsigned char k) {
+    if (t->size >= LZW_MAX_CODES) return;
+    size_t c = t->size++;
+    t->prefix[c] = (uint16_t)w;
+    t->suffix[c] = k;
+    t->first[c] = t->first[w];
+    t->length[c] = t->length[w] + 1;
+    uint32_t key = ((uint32_t)w << 8) | k;
+    uint32_t h = lzw_slot(key);
+    while (t->hkey[h] != LZW_HASH_EMPTY) h = (h + 1) & (LZW_HASH_SIZE - 1);
+    t->hkey[h] = key;
+    t->hcode[h] = (uint16_t)c;
+}
+
+/* runs the encoder over a trained dictionary without emitting codes */
+static void lzw_prime(LZWTable *t, const unsigned char *dict, size_t dict_len) {
+    int w = -1;
+    for (size_t i = 0; i < dict_len; ++i) {
+        unsigned char k = dict[i];
+        if (w < 0) { w = k; continue; }
+        int c = lzw_lookup(t, w, k);
+        if (c >= 0) { w = c; continue; }
+        lzw_add(t, w, k);
+        w = k;
     }
+}
 
-    // Working buffer for building w
-    unsigned char *w = NULL; size_t wlen = 0;
-    // output buffer (codes as 2 bytes big endian)
-    size_t out_cap = (in_len + 1) * 2;
-    unsigned char *obuf = malloc(out_cap);
-    if (!obuf) goto lzw_encode_fail;
+/* encodes in[0..len) continuing from the pending code *w (-1 at the
+   start); at most 2 bytes per input byte go to out. The last code stays
+   pending in *w so the next call can extend it. */
+static size_t lzw_encode_run(LZWTable *t, int *w, const unsigned char *in, size_t len, unsigned char *out) {
     size_t ow = 0;
-
-    for (size_t pos = 0; pos < in_len; ++pos) {
+    int cur = *w;
+    for (size_t pos = 0; pos < len; ++pos) {
         unsigned char k = in[pos];
-        // candidate = w + k
-        size_t cand_len = wlen + 1;
-        unsigned char *cand = malloc(cand_len);
-        if (!cand) { free(obuf); goto lzw_encode_fail; }
-        if (wlen > 0) memcpy(cand, w, wlen);
-        cand[wlen] = k;
-
-        int idx = lzw_find(dict, dict_size, cand, cand_len);
-        if (idx != -1) {
-            // w = cand
-            free(w);
-            w = cand; wlen = cand_len;
-            continue;
-        } else {
-            // output code for w
-            int code;
-            if (wlen == 0) code = (int)k; // shouldn't happen normally
-            else {
-                code = lzw_find(dict, dict_size, w, wlen);
-                if (code < 0) { free(cand); goto lzw_encode_fail; }
-            }
-            // write code as uint16 BE
-            if (ow + 2 > out_cap) {
-                out_cap *= 2; unsigned char *tmp = realloc(obuf, out_cap);
-                if (!tmp) { free(cand); free(obuf); goto lzw_encode_fail; }
-                obuf = tmp;
-            }
-            obuf[ow++] = (unsigned char)((code >> 8) & 0xFF);
-            obuf[ow++] = (unsigned char)(code & 0xFF);
-
-            // add candidate to dict
-            if (lzw_add_entry(&dict, &dict_size, &dict_cap, cand, cand_len) != 0) { free(cand); goto lzw_encode_fail; }
-            // set w = [k]
-            free(w);
-            w = malloc(1);
-            if (!w) goto lzw_encode_fail;
-            w[0] = k; wlen = 1;
-            free(cand); // already copied into dict
-        }
+        if (cur < 0) { cur = k; continue; }
+        int c = lzw_lookup(t, cur, k);
+        if (c >= 0) { cur = c; continue; }
+        out[ow++] = (unsigned char)((cur >> 8) & 0xFF);
+        out[ow++] = (unsigned char)(cur & 0xFF);
+        lzw_add(t, cur, k);
+        cur = k;
     }
+    *w = cur;
+    return ow;
+}
 
-    // output last w if any
-    if (wlen > 0) {
-        int code = lzw_find(dict, dict_size, w, wlen);
-        if (code < 0) goto lzw_encode_fail;
-        if (ow + 2 > out_cap) {
-            out_cap *= 2; unsigned char *tmp = realloc(obuf, out_cap);
-            if (!tmp) goto lzw_encode_fail;
-            obuf = tmp;
-        }
-        obuf[ow++] = (unsigned char)((code >> 8) & 0xFF);
-        obuf[ow++] = (unsigned char)(code & 0xFF);
-    }
+static size_t lzw_encode_flush(int *w, unsigned char *out) {
+    if (*w < 0) return 0;
+    out[0] = (unsigned char)((*w >> 8) & 0xFF);
+    out[1] = (unsigned char)(*w & 0xFF);
+    *w = -1;
+    return 2;
+}
+
+int alg_compress_lzw_dict_buf(const unsigned char *dict, size_t dict_len, const unsigned char *in, size_t in_len, unsigned char **out, size_t *out_len) {
+    if (!in) return 1;
+    LZWTable *t = lzw_table_new();
+    if (!t) return 1;
+    if (dict && dict_len > 0) lzw_prime(t, dict, dict_len);
+
+    // every input byte produces at most one code (2 bytes big endian)
+    unsigned char *obuf = malloc(in_len * 2 + 2);
+    if (!obuf) { free(t); return 1; }
 
-    // cleanup dict and w
-    for (size_t i = 0; i < dict_size; ++i) free(dict[i].data);
-    free(dict);
-    free(w);
+    int w = -1;
+    size_t ow = lzw_encode_run(t, &w, in, in_len, obuf);
+    ow += lzw_encode_flush(&w, obuf + ow);
 
+    free(t);
     *out = obuf; *out_len = ow;
     return 0;
+}
 
-lzw_encode_fail:
-    if (dict) { for (size_t i = 0; i < dict_size; ++i) if (dict[i].data) free(dict[i].data); free(dict); }
-    if (w) free(w);
-    return 1;
+int alg_compress_lzw_buf(const unsigned char *in, size_t in_len, unsigned char **out, size_t *out_len) {
+    return alg_compress_lzw_dict_buf(NULL, 0, in, in_len, out, out_len);
 }
 
-int alg_decompress_lzw_buf(const unsigned char *in, size_t in_len, unsigned char **out, size_t *out_len) {
-    if (!in) return 1;
-    // build dict: index->string
-    LZWEntry *dict = NULL; size_t dict_size = 0, dict_cap = 0;
-    for (int i = 0; i < 256; ++i) {
-        unsigned char b = (unsigned char)i;
-        if (lzw_add_entry(&dict, &dict_size, &dict_cap, &b, 1) != 0) goto lzw_decode_fail;
-    }
+/* length of the string for code after prev, or 0 if the code is invalid
+   here (only the next free code may be unknown: the KwKwK case) */
+static size_t lzw_entry_len(const LZWTable *t, int prev, int code) {
+    if (code < (int)t->size) return t->length[code];
+    if (prev < 0 || code != (int)t->size) return 0;
+    return (size_t)t->length[prev] + 1;
+}
+
+/* writes the string of code (entry_len bytes) at dst and adds the entry
+   prev_string + first_char(entry) */
+static void lzw_decode_entry(LZWTable *t, int *prev, int code, unsigned char *dst, size_t entry_len) {
+    unsigned char *p = dst + entry_len;
+    int c = code;
+    if (code >= (int)t->size) { *--p = t->first[*prev]; c = *prev; }
+    // write the string backwards by following the prefix chain
+    while (c >= 256) { *--p = t->suffix[c]; c = t->prefix[c]; }
+    *--p = (unsigned char)c;
+    if (*prev >= 0) lzw_add(t, *prev, dst[0]);
+    *prev = code;
+}
 
+int alg_decompress_lzw_dict_buf(const unsigned char *dict, size_t dict_len, const unsigned char *in, size_t in_len, unsigned char **out, size_t *out_len) {
+    if (!in) return 1;
     // read codes as uint16 BE
-    if (in_len % 2 != 0) goto lzw_decode_fail;
+    if (in_len % 2 != 0) return 1;
+    LZWTable *t = lzw_table_new();
+    if (!t) return 1;
+    if (dict && dict_len > 0) lzw_prime(t, dict, dict_len);
+
     size_t codes = in_len / 2;
     size_t out_cap = 1024;
     unsigned char *obuf = malloc(out_cap);
@@ -249,61 +313,32 @@ int alg_decompress_lzw_buf(const unsigned char *in, size_t in_len, unsigned char
     int prev_code = -1;
     for (size_t i = 0; i < codes; ++i) {
         int code = (in[2*i] << 8) | in[2*i+1];
-        unsigned char *entry = NULL; size_t entry_len = 0;
-
-        if (code < (int)dict_size) {
-            entry_len = dict[code].len;
-            entry = malloc(entry_len);
-            if (!entry) goto lzw_decode_fail;
-            memcpy(entry, dict[code].data, entry_len);
-        } else {
-            // Special case (KwKwK): entry = prev_string + first_char(prev_string)
-            if (prev_code < 0) goto lzw_decode_fail;
-            size_t plen = dict[prev_code].len;
-            entry = malloc(plen + 1);
-            if (!entry) goto lzw_decode_fail;
-            memcpy(entry, dict[prev_code].data, plen);
-            entry[plen] = dict[prev_code].data[0];
-            entry_len = plen + 1;
-        }
-
-        // append entry to output
+        size_t entry_len = lzw_entry_len(t, prev_code, code);
+        if (entry_len == 0) goto lzw_decode_fail;
         if (ow + entry_len > out_cap) {
             while (ow + entry_len > out_cap) out_cap *= 2;
             unsigned char *tmp = realloc(obuf, out_cap);
-            if (!tmp) { free(entry); goto lzw_decode_fail; }
+            if (!tmp) goto lzw_decode_fail;
             obuf = tmp;
         }
-        memcpy(obuf + ow, entry, entry_len);
+        lzw_decode_entry(t, &prev_code, code, obuf + ow, entry_len);
         ow += entry_len;
-
-        // add new dict entry: prev_string + first_char(entry)
-        if (prev_code >= 0) {
-            size_t plen = dict[prev_code].len;
-            unsigned char *newstr = malloc(plen + 1);
-            if (!newstr) { free(entry); goto lzw_decode_fail; }
-            memcpy(newstr, dict[prev_code].data, plen);
-            newstr[plen] = entry[0];
-            if (lzw_add_entry(&dict, &dict_size, &dict_cap, newstr, plen + 1) != 0) { free(newstr); free(entry); goto lzw_decode_fail; }
-            // lzw_add_entry copied newstr
-            free(newstr);
-        }
-
-        free(entry);
-        prev_code = code;
     }
 
-    for (size_t i = 0; i < dict_size; ++i) free(dict[i].data);
-    free(dict);
-
+    free(t);
     *out = obuf; *out_len = ow;
     return 0;
 
 lzw_decode_fail:
-    if (dict) { for (size_t i = 0; i < dict_size; ++i) if (dict[i].data) free(dict[i].data); free(dict); }
+    free(obuf);
+    free(t);
     return 1;
 }
 
+int alg_decompress_lzw_buf(const unsigned char *in, size_t in_len, unsigned char **out, size_t *out_len) {
+    return alg_decompress_lzw_dict_buf(NULL, 0, in, in_len, out, out_len);
+}
+
 /* Wrapper functions to compress/decompress buffers using RLE or LZW */
 int alg_compress_lzw_buf_wrapper(const unsigned char *in, size_t in_len, unsigned char **out, size_t *out_len) {
     return alg_compress_lzw_buf(in, in_len, out, out_len);
@@ -338,24 +373,16 @@ static void feistel_key_schedule(const unsigned char *key, size_t key_len, uint3
     }
 }
 
-/* round function F: mix using addition, xor, rotates */
-static uint32_t feistel_F(uint32_t half, uint32_t rk) {
-    uint32_t x = half;
-    x = x + rk;
-    x = x ^ rol32(half, 5);
-    x = x + ((rk ^ 0xA5A5A5A5u) & 0xFFFFFFFFu);
-    x = rol32(x, 11);
-    x ^= (rk >> 3);
-    return x;
-}
+/* round function F lives in kernels.h (feistel_round_f): the vector
+   decryptors in kernels.c evaluate the same mix on several blocks */
 
 /* encrypt single 8-byte block in place */
-static void feistel_encrypt_block(uint8_t block[8], uint32_t round_keys[16]) {
+static void feistel_encrypt_block(uint8_t block[8], const uint32_t round_keys[16]) {
     uint32_t L = (block[0]<<24)|(block[1]<<16)|(block[2]<<8)|block[3];
     uint32_t R = (block[4]<<24)|(block[5]<<16)|(block[6]<<8)|block[7];
     for (int r = 0; r < 16; ++r) {
         uint32_t newL = R;
-        uint32_t newR = L ^ feistel_F(R, round_keys[r]);
+        uint32_t newR = L ^ feistel_round_f(R, round_keys[r]);
         L = newL; R = newR;
     }
     // pack back (note: after 16 rounds, swap or not? Here the Feistel structure already swapped each round)
@@ -363,198 +390,719 @@ static void feistel_encrypt_block(uint8_t block[8], uint32_t round_keys[16]) {
     block[4] = (R >> 24) & 0xFF; block[5] = (R >> 16) & 0xFF; block[6] = (R >> 8) & 0xFF; block[7] = R & 0xFF;
 }
 
-/* decrypt single block */
-static void feistel_decrypt_block(uint8_t block[8], uint32_t round_keys[16]) {
-    uint32_t L = (block[0]<<24)|(block[1]<<16)|(block[2]<<8)|block[3];
-    uint32_t R = (block[4]<<24)|(block[5]<<16)|(block[6]<<8)|block[7];
-    for (int r = 15; r >= 0; --r) {
-        uint32_t newR = L;
-        uint32_t newL = R ^ feistel_F(L, round_keys[r]);
-        L = newL; R = newR;
-    }
-    block[0] = (L >> 24) & 0xFF; block[1] = (L >> 16) & 0xFF; block[2] = (L >> 8) & 0xFF; block[3] = L & 0xFF;
-    block[4] = (R >> 24) & 0xFF; block[5] = (R >> 16) & 0xFF; block[6] = (R >> 8) & 0xFF; block[7] = R & 0xFF;
+/* CBC XOR helper */
+static void xor_block(uint8_t *dst, const uint8_t *a, const uint8_t *b) {
+    uint64_t x, y;
+    memcpy(&x, a, 8);
+    memcpy(&y, b, 8);
+    x ^= y;
+    memcpy(dst, &x, 8);
 }
 
-/* PKCS#7-like padding for block size 8 */
-static unsigned char *pad_pkcs7(const unsigned char *in, size_t in_len, size_t *out_len) {
-    size_t block = 8;
-    size_t pad = block - (in_len % block);
-    *out_len = in_len + pad;
-    unsigned char *out = malloc(*out_len);
-    if (!out) return NULL;
-    memcpy(out, in, in_len);
-    for (size_t i = 0; i < pad; ++i) out[in_len + i] = (unsigned char)pad;
-    return out;
-}
-static unsigned char *unpad_pkcs7(unsigned char *in, size_t in_len, size_t *out_len) {
-    if (in_len == 0 || in_len % 8 != 0) return NULL;
-    unsigned char pad = in[in_len - 1];
-    if (pad == 0 || pad > 8) return NULL;
-    for (size_t i = 0; i < pad; ++i) {
-        if (in[in_len - 1 - i] != pad) return NULL;
-    }
-    *out_len = in_len - pad;
-    unsigned char *out = malloc(*out_len);
-    if (!out) return NULL;
-    memcpy(out, in, *out_len);
-    return out;
+/* -------------------------------------------------------
+   Keyed context and raw CBC over whole blocks, for callers that
+   process data in pieces (see include/algorithms/feistel.h)
+   ------------------------------------------------------- */
+
+void feistel_init(FeistelKey *fk, const unsigned char *key, size_t key_len) {
+    feistel_key_schedule(key, key_len, fk->round_keys);
 }
 
-/* CBC XOR helper */
-static void xor_block(uint8_t *dst, const uint8_t *a, const uint8_t *b) {
-    for (int i = 0; i < 8; ++i) dst[i] = a[i] ^ b[i];
+int feistel_random_iv(uint8_t iv[8]) {
+    return read_random_bytes(iv, 8);
 }
 
-/* Feistel encrypt buffer (writes IV + ciphertext into out) */
-static int feistel_encrypt_buffer(const unsigned char *in, size_t in_len, const unsigned char *key, size_t key_len, unsigned char **out, size_t *out_len) {
-    uint32_t round_keys[16];
-    feistel_key_schedule(key, key_len, round_keys);
+void feistel_cbc_encrypt(const FeistelKey *fk, uint8_t iv[8], const unsigned char *in, unsigned char *out, size_t len) {
+    for (size_t pos = 0; pos + 8 <= len; pos += 8) {
+        uint8_t block[8];
+        xor_block(block, in + pos, iv);
+        feistel_encrypt_block(block, fk->round_keys);
+        memcpy(out + pos, block, 8);
+        memcpy(iv, block, 8);
+    }
+}
 
-    size_t padded_len;
-    unsigned char *padded = pad_pkcs7(in, in_len, &padded_len);
-    if (!padded) return 1;
+/* CBC decryption has no chain between block decryptions, only in the
+   final XOR: decrypt a chunk of blocks at once with the dispatched
+   kernel, then XOR with the shifted ciphertext (kept in 8 + chunk
+   bytes of stack so that in may alias out). */
+#define CBC_DECRYPT_CHUNK 512
 
-    // allocate out: IV(8) + padded_len
-    *out_len = 8 + padded_len;
-    unsigned char *obuf = malloc(*out_len);
-    if (!obuf) { free(padded); return 1; }
+void feistel_cbc_decrypt(const FeistelKey *fk, uint8_t iv[8], const unsigned char *in, unsigned char *out, size_t len) {
+    const Kernels *k = kernels();
+    unsigned char prev[8 + CBC_DECRYPT_CHUNK];
+    unsigned char dec[CBC_DECRYPT_CHUNK];
+    len -= len % 8;
+    for (size_t pos = 0; pos < len; pos += CBC_DECRYPT_CHUNK) {
+        size_t n = len - pos < CBC_DECRYPT_CHUNK ? len - pos : CBC_DECRYPT_CHUNK;
+        memcpy(prev, iv, 8);
+        memcpy(prev + 8, in + pos, n);
+        k->feistel_decrypt_blocks(fk->round_keys, prev + 8, dec, n / 8);
+        k->xor_bytes(out + pos, dec, prev, n);
+        memcpy(iv, prev + n, 8);
+    }
+}
 
-    // IV
-    if (read_random_bytes(obuf, 8) != 0) { free(padded); free(obuf); return 1; }
+int feistel_unpad(const unsigned char *last_block, size_t *pad_len) {
+    unsigned char pad = last_block[7];
+    if (pad == 0 || pad > 8) return 1;
+    for (size_t i = 0; i < pad; ++i) {
+        if (last_block[7 - i] != pad) return 1;
+    }
+    *pad_len = pad;
+    return 0;
+}
 
-    uint8_t prev[8];
-    memcpy(prev, obuf, 8);
+/* Cipher header (layout in feistel.h): the key-check value is the
+   encryption of the IV under a fixed mask, so it differs per file
+   and says nothing about the key beyond one block of a random IV;
+   a wrong key fails here, before any bulk decryption. Headers without
+   the magic are the legacy IV-only format. */
+static const unsigned char feistel_magic[3] = { 'G', 'S', 'E' };
+static const unsigned char feistel_kcv_mask[8] = { 'G', 'S', 'E', 'A', '-', 'K', 'C', 'V' };
+#define FEISTEL_VERSION 1
 
-    // CBC encryption
-    for (size_t pos = 0; pos < padded_len; pos += 8) {
-        uint8_t block[8];
-        xor_block(block, padded + pos, prev);        // block = plaintext ^ prev
-        feistel_encrypt_block(block, round_keys);   // encrypt
-        memcpy(obuf + 8 + pos, block, 8);
-        memcpy(prev, block, 8);
-    }
+static void feistel_kcv(const FeistelKey *fk, const uint8_t iv[8], unsigned char kcv[FEISTEL_KCV_LEN]) {
+    uint8_t block[8];
+    xor_block(block, iv, feistel_kcv_mask);
+    feistel_encrypt_block(block, fk->round_keys);
+    memcpy(kcv, block, FEISTEL_KCV_LEN);
+}
 
-    free(padded);
-    *out = obuf;
+void feistel_write_header(const FeistelKey *fk, const uint8_t iv[8], unsigned char out[FEISTEL_HEADER_LEN]) {
+    memcpy(out, feistel_magic, 3);
+    out[3] = FEISTEL_VERSION;
+    feistel_kcv(fk, iv, out + 4);
+    memcpy(out + 8, iv, 8);
+}
+
+int feistel_read_header(const FeistelKey *fk, const unsigned char *in, size_t len, uint8_t iv[8], size_t *header_len) {
+    if (len >= FEISTEL_HEADER_LEN && memcmp(in, feistel_magic, 3) == 0 && in[3] == FEISTEL_VERSION) {
+        unsigned char kcv[FEISTEL_KCV_LEN];
+        memcpy(iv, in + 8, 8);
+        feistel_kcv(fk, iv, kcv);
+        if (memcmp(kcv, in + 4, FEISTEL_KCV_LEN) != 0) {
+            fprintf(stderr, "[feistel] clave incorrecta (el KCV no coincide)\n");
+            return 1;
+        }
+        *header_len = FEISTEL_HEADER_LEN;
+        return 0;
+    }
+    if (len < FEISTEL_LEGACY_HEADER_LEN) {
+        fprintf(stderr, "[feistel] texto cifrado truncado\n");
+        return 1;
+    }
+    memcpy(iv, in, 8);
+    *header_len = FEISTEL_LEGACY_HEADER_LEN;
     return 0;
 }
 
-/* Feistel decrypt buffer (expects IV + ciphertext) */
-static int feistel_decrypt_buffer(const unsigned char *in, size_t in_len, const unsigned char *key, size_t key_len, unsigned char **out, size_t *out_len) {
-    if (in_len < 8) return 1; // must have IV
-    uint32_t round_keys[16];
-    feistel_key_schedule(key, key_len, round_keys);
+/* Whole-buffer encrypt / decrypt in place (layout in feistel.h):
+   the plaintext sits after a gap that receives the header, the
+   PKCS#7 padding goes into the tail room, and CBC runs over the same
+   memory. Decryption strips the padding by shortening the length. */
+int feistel_encrypt_inplace(const FeistelKey *fk, unsigned char *buf, size_t len, size_t *out_len) {
+    size_t pad = 8 - (len % 8);
+    unsigned char *data = buf + FEISTEL_HEADROOM;
+    memset(data + len, (int)pad, pad);
 
-    const unsigned char *iv = in;
-    const unsigned char *ct = in + 8;
-    size_t ct_len = in_len - 8;
-    if (ct_len % 8 != 0) return 1;
+    uint8_t iv[8];
+    if (read_random_bytes(iv, 8) != 0) return 1;
+    feistel_write_header(fk, iv, buf);
+    feistel_cbc_encrypt(fk, iv, data, data, len + pad);
+    *out_len = FEISTEL_HEADROOM + len + pad;
+    return 0;
+}
 
-    unsigned char *plain_padded = malloc(ct_len);
-    if (!plain_padded) return 1;
+int feistel_decrypt_inplace(const FeistelKey *fk, unsigned char *buf, size_t len, size_t *plain_off, size_t *plain_len) {
+    uint8_t iv[8];
+    size_t hdr;
+    if (feistel_read_header(fk, buf, len, iv, &hdr) != 0) return 1;
+    if (len < hdr + 8 || (len - hdr) % 8 != 0) return 1; // header + at least one block
+    size_t ct_len = len - hdr;
+    unsigned char *data = buf + hdr;
 
-    uint8_t prev[8];
-    memcpy(prev, iv, 8);
+    feistel_cbc_decrypt(fk, iv, data, data, ct_len);
 
-    for (size_t pos = 0; pos < ct_len; pos += 8) {
-        uint8_t block[8];
-        memcpy(block, ct + pos, 8);
-        uint8_t dec[8];
-        memcpy(dec, block, 8);
-        feistel_decrypt_block(dec, round_keys);
-        // plaintext = dec ^ prev
-        for (int i = 0; i < 8; ++i) plain_padded[pos + i] = dec[i] ^ prev[i];
-        memcpy(prev, block, 8);
-    }
-
-    unsigned char *unpadded = unpad_pkcs7(plain_padded, ct_len, out_len);
-    free(plain_padded);
-    if (!unpadded) return 1;
-    *out = unpadded;
+    size_t pad;
+    if (feistel_unpad(data + ct_len - 8, &pad) != 0) return 1;
+    *plain_off = hdr;
+    *plain_len = ct_len - pad;
     return 0;
 }
 
 /* =======================================================
    High-level wrappers that operate on files (paths)
-   - Choose RLE or LZW for compression using env var GSEA_COMP
+   - Compression algorithm comes from CompressOptions (-a)
    - Encryption uses Feistel-CBC
    ======================================================= */
 
-int alg_compress_copy(const char *in_path, const char *out_path) {
-    // choose algorithm
-    const char *env = getenv("GSEA_COMP");
-    size_t in_len;
-    unsigned char *in_buf = read_file_complete(in_path, &in_len);
+/* -------------------------------------------------------
+   Compressed container (layout in include/algorithms/container.h)
+   Files written before the header existed have none; they are
+   decoded by trial (selected algorithm, then LZW, then RLE).
+   ------------------------------------------------------- */
+
+static const unsigned char gsz_magic[3] = { 'G', 'S', 'Z' };
+
+size_t gsz_write_header(unsigned char hdr[GSZ_HEADER_MAX_LEN], CompressionAlgorithm alg, uint64_t raw_len, const CompressDict *dict, int nested) {
+    memcpy(hdr, gsz_magic, 3);
+    hdr[3] = (unsigned char)alg | (dict ? GSZ_FLAG_DICT : 0) | (nested && alg == ALG_HUFFMAN ? GSZ_FLAG_NESTED : 0);
+    for (int i = 0; i < 8; ++i) hdr[4 + i] = (unsigned char)(raw_len >> (8 * i));
+    if (!dict) return GSZ_HEADER_LEN;
+    for (int i = 0; i < 4; ++i) hdr[12 + i] = (unsigned char)(dict->id >> (8 * i));
+    return GSZ_HEADER_MAX_LEN;
+}
+
+size_t gsz_read_header(const unsigned char *in, size_t in_len, CompressionAlgorithm *alg, uint64_t *raw_len, uint32_t *dict_id, int *nested) {
+    if (in_len < GSZ_HEADER_LEN || memcmp(in, gsz_magic, 3) != 0) return 0;
+    unsigned char id = in[3] & ~(GSZ_FLAG_DICT | GSZ_FLAG_NESTED);
+    if (id != ALG_LZW && id != ALG_RLE && id != ALG_LZSS && id != ALG_HUFFMAN) return 0;
+    if ((in[3] & GSZ_FLAG_NESTED) && id != ALG_HUFFMAN) return 0;
+    *alg = (CompressionAlgorithm)id;
+    if (nested) *nested = (in[3] & GSZ_FLAG_NESTED) != 0;
+    *raw_len = 0;
+    for (int i = 0; i < 8; ++i) *raw_len |= (uint64_t)in[4 + i] << (8 * i);
+    *dict_id = 0;
+    if (!(in[3] & GSZ_FLAG_DICT)) return GSZ_HEADER_LEN;
+    if (in_len < GSZ_HEADER_MAX_LEN) return 0;
+    for (int i = 0; i < 4; ++i) *dict_id |= (uint32_t)in[12 + i] << (8 * i);
+    return GSZ_HEADER_MAX_LEN;
+}
+
+CompressionAlgorithm alg_parse_algorithm(const char *name) {
+    if (!name) return 0;
+    if (strcmp(name, "lzw") == 0 || strcmp(name, "LZW") == 0) return ALG_LZW;
+    if (strcmp(name, "rle") == 0 || strcmp(name, "RLE") == 0) return ALG_RLE;
+    if (strcmp(name, "lzss") == 0 || strcmp(name, "LZSS") == 0 ||
+        strcmp(name, "lz77") == 0 || strcmp(name, "LZ77") == 0) return ALG_LZSS;
+    if (strcmp(name, "huffman") == 0 || strcmp(name, "huff") == 0) return ALG_HUFFMAN;
+    return 0;
+}
+
+const CompressDict *gsz_dict_for(const CompressOptions *opts) {
+    // only the dictionary coders record (and need) the dictionary
+    return (opts->algorithm == ALG_LZW || opts->algorithm == ALG_LZSS) ? opts->dict : NULL;
+}
+
+int gsz_encode_block(const CompressOptions *opts, const unsigned char *in, size_t in_len, unsigned char **out, size_t *out_len) {
+    const CompressDict *dict = gsz_dict_for(opts);
+    const unsigned char *dict_data = dict ? dict->data : NULL;
+    size_t dict_len = dict ? dict->len : 0;
+    int rc;
+    if (opts->algorithm == ALG_RLE) {
+        trace_begin("rle", NULL);
+        rc = alg_compress_rle_buf(in, in_len, out, out_len);
+    } else if (opts->algorithm == ALG_LZSS) {
+        trace_begin("lzss", NULL);
+        rc = alg_compress_lzss_buf(dict_data, dict_len, in, in_len, opts->level, opts->window_bits, out, out_len);
+    } else if (opts->algorithm == ALG_HUFFMAN) {
+        trace_begin("huffman", NULL);
+        rc = alg_compress_huffman_buf(in, in_len, out, out_len);
+    } else {
+        trace_begin("lzw", NULL);
+        rc = alg_compress_lzw_dict_buf(dict_data, dict_len, in, in_len, out, out_len);
+    }
+    trace_end();
+    return rc;
+}
+
+int gsz_decode_block(CompressionAlgorithm alg, const CompressDict *dict, const unsigned char *in, size_t in_len, size_t raw_len, unsigned char **out, size_t *out_len) {
+    const unsigned char *dict_data = dict ? dict->data : NULL;
+    size_t dict_len = dict ? dict->len : 0;
+    int rc;
+    if (alg == ALG_LZSS) {
+        trace_begin("lzss decode", NULL);
+        rc = alg_decompress_lzss_buf(dict_data, dict_len, in, in_len, raw_len, out, out_len);
+    } else if (alg == ALG_HUFFMAN) {
+        trace_begin("huffman decode", NULL);
+        rc = alg_decompress_huffman_buf(in, in_len, raw_len, out, out_len);
+    } else if (alg == ALG_RLE) {
+        trace_begin("rle decode", NULL);
+        rc = alg_decompress_rle_buf(in, in_len, out, out_len);
+    } else {
+        trace_begin("lzw decode", NULL);
+        rc = alg_decompress_lzw_dict_buf(dict_data, dict_len, in, in_len, out, out_len);
+    }
+    trace_end();
+    if (rc == 0 && *out_len != raw_len) { free(*out); *out = NULL; rc = 1; }
+    return rc;
+}
+
+int gsz_check_dict(uint32_t dict_id, const CompressDict *dict, const CompressDict **use) {
+    *use = NULL;
+    if (dict_id == 0) return 0;
+    if (!dict || dict->id != dict_id) {
+        fprintf(stderr, "[alg_decompress_copy] El archivo requiere el diccionario %08x (usar -D)\n", dict_id);
+        return 1;
+    }
+    *use = dict;
+    return 0;
+}
+
+int gsz_decode_legacy(const unsigned char *in, size_t in_len, const CompressOptions *opts, unsigned char **out, size_t *out_len) {
+    if (opts && opts->algorithm == ALG_RLE) {
+        // honour the selected algorithm
+        return alg_decompress_rle_buf(in, in_len, out, out_len);
+    }
+    // try LZW first
+    if (alg_decompress_lzw_buf(in, in_len, out, out_len) == 0) return 0;
+    // fallback to RLE
+    return alg_decompress_rle_buf(in, in_len, out, out_len);
+}
+
+/* -------------------------------------------------------
+   Tile coders: a single-block LZW / RLE payload produced or consumed
+   piece by piece. The coder state (LZW table and pending code, RLE
+   pending run, half of a 2-byte unit) carries over between pieces, so
+   the bytes are exactly those of gsz_encode_block / gsz_decode_block
+   while only one tile is ever held in memory.
+   ------------------------------------------------------- */
+
+struct GszTileCoder {
+    CompressionAlgorithm alg;
+    int decode;
+    LZWTable *lzw;
+    int code;                 /* LZW: pending (encode) / previous (decode) code */
+    RLERun run;
+    unsigned char half[1];    /* decode: first byte of an incomplete unit */
+    int has_half;
+    unsigned char *out;
+    size_t out_len, out_cap;
+    uint64_t total;           /* bytes produced */
+};
+
+int gsz_tile_supported(CompressionAlgorithm alg) {
+    return alg == ALG_LZW || alg == ALG_RLE;
+}
+
+static GszTileCoder *gsz_tile_new(CompressionAlgorithm alg, const CompressDict *dict, int decode) {
+    if (!gsz_tile_supported(alg)) return NULL;
+    GszTileCoder *tc = calloc(1, sizeof(GszTileCoder));
+    if (!tc) { perror("[gsz_tile_new] calloc"); return NULL; }
+    tc->alg = alg;
+    tc->decode = decode;
+    tc->code = -1;
+    /* encode: 2 bytes per input byte; decode: a tile plus the longest
+       LZW string (or RLE run) that may overshoot it */
+    tc->out_cap = decode ? GSZ_TILE_LEN + LZW_MAX_CODES : 2 * GSZ_TILE_LEN + 2;
+    tc->out = malloc(tc->out_cap);
+    if (tc->out && alg == ALG_LZW) {
+        tc->lzw = lzw_table_new();
+        if (tc->lzw && dict) lzw_prime(tc->lzw, dict->data, dict->len);
+    }
+    if (!tc->out || (alg == ALG_LZW && !tc->lzw)) {
+        perror("[gsz_tile_new] malloc");
+        gsz_tile_free(tc);
+        return NULL;
+    }
+    return tc;
+}
+
+GszTileCoder *gsz_tile_encoder_new(const CompressOptions *opts) {
+    return gsz_tile_new(opts->algorithm, gsz_dict_for(opts), 0);
+}
+
+GszTileCoder *gsz_tile_decoder_new(CompressionAlgorithm alg, const CompressDict *dict) {
+    return gsz_tile_new(alg, alg == ALG_LZW ? dict : NULL, 1);
+}
+
+void gsz_tile_free(GszTileCoder *tc) {
+    if (!tc) return;
+    free(tc->lzw);
+    free(tc->out);
+    free(tc);
+}
+
+uint64_t gsz_tile_total(const GszTileCoder *tc) {
+    return tc->total;
+}
+
+static int tile_flush(GszTileCoder *tc, GszTileEmit emit, void *ctx) {
+    if (tc->out_len == 0) return 0;
+    tc->total += tc->out_len;
+    int rc = emit(ctx, tc->out, tc->out_len);
+    tc->out_len = 0;
+    return rc;
+}
+
+/* one 2-byte LZW code or one RLE (count, value) pair */
+static int tile_decode_unit(GszTileCoder *tc, unsigned char a, unsigned char b) {
+    if (tc->alg == ALG_RLE) {
+        memset(tc->out + tc->out_len, b, a);
+        tc->out_len += a;
+        return 0;
+    }
+    int code = (a << 8) | b;
+    size_t entry_len = lzw_entry_len(tc->lzw, tc->code, code);
+    if (entry_len == 0) return 1;
+    lzw_decode_entry(tc->lzw, &tc->code, code, tc->out + tc->out_len, entry_len);
+    tc->out_len += entry_len;
+    return 0;
+}
+
+static int tile_decode(GszTileCoder *tc, const unsigned char *in, size_t len, GszTileEmit emit, void *ctx) {
+    size_t i = 0;
+    if (tc->has_half && len > 0) {
+        tc->has_half = 0;
+        if (tile_decode_unit(tc, tc->half[0], in[i++]) != 0) return 1;
+    }
+    for (; i + 1 < len; i += 2) {
+        if (tc->out_len >= GSZ_TILE_LEN && tile_flush(tc, emit, ctx) != 0) return 1;
+        if (tile_decode_unit(tc, in[i], in[i + 1]) != 0) return 1;
+    }
+    if (i < len) {
+        tc->half[0] = in[i];
+        tc->has_half = 1;
+    }
+    return tc->out_len >= GSZ_TILE_LEN ? tile_flush(tc, emit, ctx) : 0;
+}
+
+int gsz_tile_push(GszTileCoder *tc, const unsigned char *in, size_t len, GszTileEmit emit, void *ctx) {
+    if (tc->decode) {
+        trace_begin(tc->alg == ALG_LZW ? "lzw decode" : "rle decode", NULL);
+        int rc = tile_decode(tc, in, len, emit, ctx);
+        trace_end();
+        if (rc != 0) fprintf(stderr, "[gsz_tile_push] datos comprimidos corruptos\n");
+        return rc;
+    }
+    while (len > 0) {
+        size_t n = len < GSZ_TILE_LEN ? len : GSZ_TILE_LEN;
+        trace_begin(tc->alg == ALG_LZW ? "lzw" : "rle", NULL);
+        tc->out_len = tc->alg == ALG_LZW ? lzw_encode_run(tc->lzw, &tc->code, in, n, tc->out)
+                                         : rle_encode_run(&tc->run, in, n, tc->out);
+        trace_end();
+        if (tile_flush(tc, emit, ctx) != 0) return 1;
+        in += n;
+        len -= n;
+    }
+    return 0;
+}
+
+int gsz_tile_finish(GszTileCoder *tc, GszTileEmit emit, void *ctx) {
+    if (tc->decode) {
+        if (tc->has_half) {
+            fprintf(stderr, "[gsz_tile_finish] datos comprimidos truncados\n");
+            return 1;
+        }
+        return tile_flush(tc, emit, ctx);
+    }
+    tc->out_len = tc->alg == ALG_LZW ? lzw_encode_flush(&tc->code, tc->out)
+                                     : rle_encode_flush(&tc->run, tc->out);
+    return tile_flush(tc, emit, ctx);
+}
+
+/* framed stream: sparse inputs (holes become hole frames and are never
+   read) and seekable output (frames + index) */
+static int compress_framed_copy(int in_fd, const char *out_path, const CompressOptions *opts) {
+    OutputFile of;
+    if (output_open(&of, out_path, 0) != 0) return 1;
+    int rc = 1;
+    StreamStage *st = stream_compress_new(opts, STREAM_BLOCK_SIZE);
+    if (st) {
+        stream_set_sink(st, stream_fd_sink, &of.fd);
+        rc = stream_run_fd(st, in_fd);
+        stream_free(st);
+    }
+    if (rc == 0) return output_commit(&of);
+    output_abort(&of);
+    return rc;
+}
+
+static int compress_file(const char *in_path, const char *out_path, const CompressOptions *opts) {
+    CompressOptions defaults = { ALG_LZW, 0, 0, NULL, 0, 0 };
+    if (!opts) opts = &defaults;
+
+    int in_fd = safe_open(in_path, O_RDONLY, 0);
+    if (in_fd < 0) return 1;
+    if (opts->seekable || fd_is_sparse(in_fd)) {
+        int rc = compress_framed_copy(in_fd, out_path, opts);
+        safe_close(in_fd);
+        return rc;
+    }
+
+    /* same fd as the sparseness check: one open, and the same file */
+    size_t in_len = 0;
+    trace_begin("read", NULL);
+    unsigned char *in_buf = read_fd_headroom(in_fd, 0, 0, &in_len);
+    trace_end();
+    safe_close(in_fd);
     if (!in_buf) return 1;
 
     unsigned char *out_buf = NULL;
     size_t out_len = 0;
-    int rc = 1;
-    if (env && strcmp(env, "RLE") == 0) {
-        rc = alg_compress_rle_buf(in_buf, in_len, &out_buf, &out_len);
-    } else {
-        rc = alg_compress_lzw_buf(in_buf, in_len, &out_buf, &out_len);
-    }
+    int rc = gsz_encode_block(opts, in_buf, in_len, &out_buf, &out_len);
     free(in_buf);
     if (rc != 0) { if (out_buf) free(out_buf); return 1; }
 
-    int wrc = write_buffer_to_file(out_path, out_buf, out_len);
+    unsigned char hdr[GSZ_HEADER_MAX_LEN];
+    size_t hdr_len = gsz_write_header(hdr, opts->algorithm, (uint64_t)in_len, gsz_dict_for(opts), opts->nested);
+    int wrc = write_buffers_to_file(out_path, hdr, hdr_len, out_buf, out_len);
     free(out_buf);
     return wrc;
 }
 
-int alg_decompress_copy(const char *in_path, const char *out_path) {
-    // try both: if env forces RLE try RLE decode; if not, attempt LZW then RLE fallback.
-    const char *env = getenv("GSEA_COMP");
-    size_t in_len;
-    unsigned char *in_buf = read_file_complete(in_path, &in_len);
-    if (!in_buf) return 1;
+static int decompress_file(const char *in_path, const char *out_path, const CompressOptions *opts) {
+    // the streaming decoder understands every layout (single block, frames,
+    // Huffman wrapping another container, legacy files without header)
+    int in_fd = safe_open(in_path, O_RDONLY, 0);
+    if (in_fd < 0) return 1;
+    OutputFile of;
+    if (output_open(&of, out_path, 0) != 0) { safe_close(in_fd); return 1; }
 
-    unsigned char *out_buf = NULL; size_t out_len = 0;
     int rc = 1;
-    if (env && strcmp(env, "RLE") == 0) {
-        rc = alg_decompress_rle_buf(in_buf, in_len, &out_buf, &out_len);
-    } else {
-        // try LZW first
-        rc = alg_decompress_lzw_buf(in_buf, in_len, &out_buf, &out_len);
-        if (rc != 0) {
-            // fallback to RLE
-            rc = alg_decompress_rle_buf(in_buf, in_len, &out_buf, &out_len);
+    StreamStage *st = stream_decompress_new(opts);
+    if (st) {
+        stream_set_sink(st, stream_fd_sink, &of.fd);
+        stream_set_hole_sink(st, stream_fd_hole_sink);
+        rc = stream_run_fd(st, in_fd);
+        stream_free(st);
+    }
+    // holes of the original become holes again (lseek past them)
+    if (rc == 0 && fd_finish_sparse(of.fd) != 0) rc = 1;
+    safe_close(in_fd);
+    if (rc == 0) return output_commit(&of);
+    output_abort(&of);
+    return rc;
+}
+
+/* -------------------------------------------------------
+   Fused -m ce / -m ud: the compressed bytes go straight from the coder
+   into the cipher stage, one tile at a time, while they are still in
+   cache; nothing intermediate is written or held whole. The container
+   is the same one alg_compress_copy writes (single block, or frames
+   for sparse / seekable inputs).
+   ------------------------------------------------------- */
+
+static int push_to_stage(void *ctx, const unsigned char *buf, size_t len) {
+    return stream_push((StreamStage *)ctx, buf, len);
+}
+
+/* single-block payload pushed into 'enc'; *mid_len = container size */
+static int compress_into_stage(int in_fd, const char *in_path, const CompressOptions *opts, StreamStage *enc, uint64_t *mid_len) {
+    struct stat sb;
+    if (fstat(in_fd, &sb) != 0) { perror("[compress_encrypt] fstat"); return 1; }
+    unsigned char hdr[GSZ_HEADER_MAX_LEN];
+
+    if (!gsz_tile_supported(opts->algorithm)) {
+        /* LZSS / Huffman need the whole input: only the temp file is saved */
+        size_t in_len;
+        unsigned char *in_buf = read_input(in_path, &in_len);
+        if (!in_buf) return 1;
+        unsigned char *out_buf = NULL;
+        size_t out_len = 0;
+        int rc = gsz_encode_block(opts, in_buf, in_len, &out_buf, &out_len);
+        free(in_buf);
+        size_t hdr_len = gsz_write_header(hdr, opts->algorithm, (uint64_t)in_len, gsz_dict_for(opts), opts->nested);
+        if (rc == 0) rc = stream_push(enc, hdr, hdr_len);
+        if (rc == 0) rc = stream_push(enc, out_buf, out_len);
+        free(out_buf);
+        *mid_len = hdr_len + out_len;
+        return rc;
+    }
+
+    size_t hdr_len = gsz_write_header(hdr, opts->algorithm, (uint64_t)sb.st_size, gsz_dict_for(opts), opts->nested);
+    GszTileCoder *tc = gsz_tile_encoder_new(opts);
+    unsigned char *tile = malloc(GSZ_TILE_LEN);
+    int rc = !tc || !tile || stream_push(enc, hdr, hdr_len) != 0;
+    uint64_t raw = 0;
+    while (rc == 0) {
+        trace_begin("read", NULL);
+        ssize_t r = safe_read(in_fd, tile, GSZ_TILE_LEN);
+        trace_end();
+        if (r < 0) rc = 1;
+        if (r <= 0) break;
+        raw += (uint64_t)r;
+        rc = gsz_tile_push(tc, tile, (size_t)r, push_to_stage, enc);
+        if ((size_t)r < GSZ_TILE_LEN) break;   /* safe_read only stops short at EOF */
+    }
+    if (rc == 0) rc = gsz_tile_finish(tc, push_to_stage, enc);
+    if (rc == 0 && raw != (uint64_t)sb.st_size) {
+        fprintf(stderr, "[compress_encrypt] %s cambió mientras se leía\n", in_path);
+        rc = 1;
+    }
+    *mid_len = hdr_len + (tc ? gsz_tile_total(tc) : 0);
+    gsz_tile_free(tc);
+    free(tile);
+    return rc;
+}
+
+static int compress_encrypt_file(const char *in_path, const char *out_path, const CompressOptions *opts, const FeistelKey *fk, uint64_t *mid_len) {
+    CompressOptions defaults = { ALG_LZW, 0, 0, NULL, 0, 0 };
+    if (!opts) opts = &defaults;
+    uint64_t mid = 0;
+    StreamStage *enc = stream_encrypt_new_key(fk);
+    if (!enc) return 1;
+    int in_fd = safe_open(in_path, O_RDONLY, 0);
+    if (in_fd < 0) { stream_free(enc); return 1; }
+    OutputFile of;
+    if (output_open(&of, out_path, 0) != 0) { safe_close(in_fd); stream_free(enc); return 1; }
+    stream_set_sink(enc, stream_fd_sink, &of.fd);
+
+    int rc;
+    if (opts->seekable || fd_is_sparse(in_fd)) {
+        StreamStage *st = stream_compress_new(opts, STREAM_BLOCK_SIZE);
+        if (st) {
+            stream_set_next(st, enc);
+            rc = stream_run_fd(st, in_fd);
+            mid = stream_bytes_out(st);
+            stream_free(st);   /* frees enc too */
+        } else {
+            rc = 1;
+            stream_free(enc);
         }
+    } else {
+        rc = compress_into_stage(in_fd, in_path, opts, enc, &mid);
+        if (rc == 0) rc = stream_finish(enc);
+        stream_free(enc);
     }
-    free(in_buf);
-    if (rc != 0) { if (out_buf) free(out_buf); return 1; }
+    safe_close(in_fd);
+    if (mid_len) *mid_len = mid;
+    if (rc == 0) return output_commit(&of);
+    output_abort(&of);
+    return rc;
+}
 
-    int wrc = write_buffer_to_file(out_path, out_buf, out_len);
-    free(out_buf);
+/* -m ud: decrypt stage feeding the decompress stage, which decodes
+   single-block LZW / RLE and framed payloads as they arrive */
+/* wrong key -> 1 after reading only the cipher header (legacy files and
+   inputs that cannot be read at an offset are left to the full pass) */
+static int feistel_check_key(int fd, const FeistelKey *fk) {
+    unsigned char hdr[FEISTEL_HEADER_LEN];
+    ssize_t n = safe_pread(fd, hdr, sizeof(hdr), 0);
+    if (n < 0) return 0;
+    uint8_t iv[8];
+    size_t hdr_len;
+    return feistel_read_header(fk, hdr, (size_t)n, iv, &hdr_len);
+}
+
+static int decrypt_decompress_file(const char *in_path, const char *out_path, const CompressOptions *opts, const FeistelKey *fk, uint64_t *mid_len) {
+    StreamStage *dec = stream_decrypt_new_key(fk);
+    StreamStage *st = stream_decompress_new(opts);
+    if (!dec || !st) { stream_free(dec); stream_free(st); return 1; }
+    stream_set_next(dec, st);
+    int in_fd = safe_open(in_path, O_RDONLY, 0);
+    if (in_fd < 0) { stream_free(dec); return 1; }
+    OutputFile of;
+    if (feistel_check_key(in_fd, fk) != 0 || output_open(&of, out_path, 0) != 0) {
+        safe_close(in_fd);
+        stream_free(dec);
+        return 1;
+    }
+
+    stream_set_sink(st, stream_fd_sink, &of.fd);
+    stream_set_hole_sink(st, stream_fd_hole_sink);
+    int rc = stream_run_fd(dec, in_fd);
+    if (mid_len) *mid_len = stream_bytes_out(dec);
+    stream_free(dec);
+    if (rc == 0 && fd_finish_sparse(of.fd) != 0) rc = 1;
+    safe_close(in_fd);
+    if (rc == 0) return output_commit(&of);
+    output_abort(&of);
+    return rc;
+}
+
+static int encrypt_file(const char *in_path, const char *out_path, const FeistelKey *fk) {
+    if (!fk) return 1;
+    size_t in_len;
+    trace_begin("read", NULL);
+    unsigned char *buf = read_file_headroom(in_path, FEISTEL_HEADROOM, FEISTEL_TAILROOM, &in_len);
+    trace_end();
+    if (!buf) return 1;
+    size_t out_len = 0;
+    trace_begin("feistel", NULL);
+    int frc = feistel_encrypt_inplace(fk, buf, in_len, &out_len);
+    trace_end();
+    int wrc = frc != 0 || write_buffer_to_file(out_path, buf, out_len);
+    free(buf);
     return wrc;
 }
 
-int alg_encrypt_copy(const char *in_path, const char *out_path, const char *key) {
-    if (!key) return 1;
-    size_t in_len; unsigned char *in_buf = read_file_complete(in_path, &in_len);
-    if (!in_buf) return 1;
-    unsigned char *out_buf = NULL; size_t out_len = 0;
-    if (feistel_encrypt_buffer(in_buf, in_len, (const unsigned char*)key, strlen(key), &out_buf, &out_len) != 0) {
-        free(in_buf); return 1;
+static int decrypt_file(const char *in_path, const char *out_path, const FeistelKey *fk) {
+    if (!fk) return 1;
+    int fd = safe_open(in_path, O_RDONLY, 0);
+    if (fd < 0) return 1;
+    // header first, then the rest of the file from the same fd
+    unsigned char *buf = NULL;
+    size_t in_len = 0;
+    if (feistel_check_key(fd, fk) == 0) {
+        trace_begin("read", NULL);
+        buf = read_fd_headroom(fd, 0, 0, &in_len);
+        trace_end();
     }
-    free(in_buf);
-    int wrc = write_buffer_to_file(out_path, out_buf, out_len);
-    free(out_buf);
+    safe_close(fd);
+    if (!buf) return 1;
+    size_t plain_off = 0, plain_len = 0;
+    trace_begin("feistel", NULL);
+    int frc = feistel_decrypt_inplace(fk, buf, in_len, &plain_off, &plain_len);
+    trace_end();
+    int wrc = frc != 0 || write_buffer_to_file(out_path, buf + plain_off, plain_len);
+    free(buf);
     return wrc;
 }
 
+/* public entry points: one trace span per call */
+
+int alg_compress_copy(const char *in_path, const char *out_path, const CompressOptions *opts) {
+    trace_begin("alg_compress_copy", NULL);
+    int rc = compress_file(in_path, out_path, opts);
+    trace_end();
+    return rc;
+}
+
+int alg_decompress_copy(const char *in_path, const char *out_path, const CompressOptions *opts) {
+    trace_begin("alg_decompress_copy", NULL);
+    int rc = decompress_file(in_path, out_path, opts);
+    trace_end();
+    return rc;
+}
+
+int alg_huffman_copy(const char *in_path, const char *out_path, int nested) {
+    CompressOptions huff = { ALG_HUFFMAN, 0, 0, NULL, 0, nested };
+    trace_begin("alg_huffman_copy", NULL);
+    int rc = compress_file(in_path, out_path, &huff);
+    trace_end();
+    return rc;
+}
+
+int alg_encrypt_copy_key(const char *in_path, const char *out_path, const FeistelKey *fk) {
+    trace_begin("alg_encrypt_copy", NULL);
+    int rc = encrypt_file(in_path, out_path, fk);
+    trace_end();
+    return rc;
+}
+
+int alg_decrypt_copy_key(const char *in_path, const char *out_path, const FeistelKey *fk) {
+    trace_begin("alg_decrypt_copy", NULL);
+    int rc = decrypt_file(in_path, out_path, fk);
+    trace_end();
+    return rc;
+}
+
+int alg_compress_encrypt_copy(const char *in_path, const char *out_path, const CompressOptions *opts, const FeistelKey *fk, uint64_t *mid_len) {
+    trace_begin("alg_compress_encrypt_copy", NULL);
+    int rc = compress_encrypt_file(in_path, out_path, opts, fk, mid_len);
+    trace_end();
+    return rc;
+}
+
+int alg_decrypt_decompress_copy(const char *in_path, const char *out_path, const CompressOptions *opts, const FeistelKey *fk, uint64_t *mid_len) {
+    trace_begin("alg_decrypt_decompress_copy", NULL);
+    int rc = decrypt_decompress_file(in_path, out_path, opts, fk, mid_len);
+    trace_end();
+    return rc;
+}
+
+int alg_encrypt_copy(const char *in_path, const char *out_path, const char *key) {
+    if (!key) return 1;
+    FeistelKey fk;
+    feistel_init(&fk, (const unsigned char *)key, strlen(key));
+    return alg_encrypt_copy_key(in_path, out_path, &fk);
+}
+
 int alg_decrypt_copy(const char *in_path, const char *out_path, const char *key) {
     if (!key) return 1;
-    size_t in_len; unsigned char *in_buf = read_file_complete(in_path, &in_len);
-    if (!in_buf) return 1;
-    unsigned char *out_buf = NULL; size_t out_len = 0;
-    if (feistel_decrypt_buffer(in_buf, in_len, (const unsigned char*)key, strlen(key), &out_buf, &out_len) != 0) {
-        free(in_buf); return 1;
-    }
-    free(in_buf);
-    int wrc = write_buffer_to_file(out_path, out_buf, out_len);
-    free(out_buf);
-    return wrc;
-}
\ No newline at end of file
+    FeistelKey fk;
+    feistel_init(&fk, (const unsigned char *)key, strlen(key));
+    return alg_decrypt_copy_key(in_path, out_path, &fk);
+}
@@ -0,0 +1,212 @@
+#define _POSIX_C_SOURCE 200809L
+#include "../../include/algorithms.h"
+#include "../../include/file.h"
+#include "../../include/utils.h"
+#include "../../include/directory.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <dirent.h>
+
+/* =======================================================
+   Trained dictionaries for many small, similar files
+   File format: "GSD" | version (1) | id (u32 LE) | content
+   - id = FNV-1a of the content, stored in every container that
+     was compressed with the dictionary
+   - training (simplified COVER): count in how many samples each
+     8-byte d-mer appears, split the samples into one epoch per
+     dictionary segment and keep the 64-byte segment of each epoch
+     whose d-mers are shared by the most samples
+   ======================================================= */
+
+#define DICT_HEADER_LEN    8
+#define DICT_DMER          8
+#define DICT_SEGMENT       64
+#define DICT_HASH_BITS     20
+#define DICT_MAX_SAMPLES   4096
+#define DICT_SAMPLE_BYTES  (64 * 1024)         /* bytes taken from each file */
+#define DICT_SAMPLE_BUDGET (8 * 1024 * 1024)   /* bytes taken in total */
+
+static const unsigned char dict_magic[3] = { 'G', 'S', 'D' };
+
+static uint32_t dict_fnv1a(const unsigned char *p, size_t n) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < n; ++i) { h ^= p[i]; h *= 16777619u; }
+    return h ? h : 1;
+}
+
+static inline uint32_t dict_dmer_hash(const unsigned char *p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return (uint32_t)((v * 0x9E3779B97F4A7C15ull) >> (64 - DICT_HASH_BITS));
+}
+
+int alg_dict_load(const char *path, CompressDict *dict) {
+    size_t len;
+    unsigned char *buf = read_file_complete(path, &len);
+    if (!buf) return 1;
+    if (len < DICT_HEADER_LEN || memcmp(buf, dict_magic, 3) != 0 || buf[3] != 1) {
+        fprintf(stderr, "[alg_dict_load] %s no es un diccionario valido\n", path);
+        free(buf);
+        return 1;
+    }
+    dict->id = (uint32_t)buf[4] | ((uint32_t)buf[5] << 8) | ((uint32_t)buf[6] << 16) | ((uint32_t)buf[7] << 24);
+    dict->len = len - DICT_HEADER_LEN;
+    memmove(buf, buf + DICT_HEADER_LEN, dict->len);
+    dict->data = buf;
+    if (dict_fnv1a(dict->data, dict->len) != dict->id) {
+        fprintf(stderr, "[alg_dict_load] %s: id no coincide con el contenido\n", path);
+        alg_dict_free(dict);
+        return 1;
+    }
+    return 0;
+}
+
+void alg_dict_free(CompressDict *dict) {
+    if (!dict) return;
+    free(dict->data);
+    dict->data = NULL;
+    dict->len = 0;
+    dict->id = 0;
+}
+
+static int dict_save(const char *path, const unsigned char *data, size_t len, uint32_t id) {
+    unsigned char hdr[DICT_HEADER_LEN];
+    memcpy(hdr, dict_magic, 3);
+    hdr[3] = 1;
+    for (int i = 0; i < 4; ++i) hdr[4 + i] = (unsigned char)(id >> (8 * i));
+
+    OutputFile of;
+    if (output_open(&of, path, sizeof(hdr) + len) != 0) return 1;
+    if (safe_write(of.fd, hdr, sizeof(hdr)) != 0 || safe_write(of.fd, data, len) != 0) {
+        output_abort(&of);
+        return 1;
+    }
+    return output_commit(&of);
+}
+
+static int dict_cmp_names(const void *a, const void *b) {
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+/* sorted list of regular files in dir (deterministic sampling) */
+static char **dict_list_files(const char *dir_path, size_t *count) {
+    DIR *dir = opendir(dir_path);
+    if (!dir) { perror("[alg_train_dictionary] opendir"); return NULL; }
+    char **names = NULL;
+    size_t n = 0, cap = 0;
+    struct dirent *e;
+    while ((e = readdir(dir)) != NULL) {
+        if (strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0) continue;
+        char *full = build_path(dir_path, e->d_name);
+        if (!full) continue;
+        if (is_directory(full)) { free(full); continue; }
+        if (n == cap) {
+            cap = cap ? cap * 2 : 64;
+            char **tmp = realloc(names, cap * sizeof(char *));
+            if (!tmp) { free(full); break; }
+            names = tmp;
+        }
+        names[n++] = full;
+    }
+    closedir(dir);
+    if (n > 0) qsort(names, n, sizeof(char *), dict_cmp_names);
+    *count = n;
+    return names;
+}
+
+int alg_train_dictionary(const char *input_dir, const char *dict_path, size_t dict_size) {
+    if (dict_size < DICT_SEGMENT) dict_size = ALG_DICT_DEFAULT_SIZE;
+    size_t nfiles = 0;
+    char **files = dict_list_files(input_dir, &nfiles);
+    if (!files || nfiles == 0) {
+        fprintf(stderr, "[alg_train_dictionary] %s no contiene archivos\n", input_dir);
+        free(files);
+        return 1;
+    }
+
+    /* 1) load a deterministic sample: every stride-th file, up to the budget */
+    size_t stride = (nfiles + DICT_MAX_SAMPLES - 1) / DICT_MAX_SAMPLES;
+    unsigned char *all = malloc(DICT_SAMPLE_BUDGET);
+    size_t *starts = malloc((DICT_MAX_SAMPLES + 1) * sizeof(size_t));
+    if (!all || !starts) { free(all); free(starts); goto train_free_files; }
+    size_t total = 0, nsamples = 0;
+    for (size_t i = 0; i < nfiles && nsamples < DICT_MAX_SAMPLES && total < DICT_SAMPLE_BUDGET; i += stride) {
+        /* only the head of each file is sampled: read just that much */
+        size_t want = DICT_SAMPLE_BUDGET - total;
+        if (want > DICT_SAMPLE_BYTES) want = DICT_SAMPLE_BYTES;
+        int fd = safe_open(files[i], O_RDONLY, 0);
+        if (fd < 0) continue;
+        ssize_t got = safe_read(fd, all + total, want);
+        safe_close(fd);
+        if (got < 0) continue;
+        size_t len = (size_t)got;
+        starts[nsamples++] = total;
+        total += len;
+    }
+    starts[nsamples] = total;
+
+    unsigned char *dict = malloc(dict_size);
+    uint32_t *freq = calloc((size_t)1 << DICT_HASH_BITS, sizeof(uint32_t));
+    uint32_t *seen = calloc((size_t)1 << DICT_HASH_BITS, sizeof(uint32_t));
+    if (!dict || !freq || !seen) { free(dict); free(freq); free(seen); free(all); free(starts); goto train_free_files; }
+    size_t dlen = 0;
+
+    if (total <= dict_size) {
+        /* tiny corpus: the samples themselves are the dictionary */
+        memcpy(dict, all, total);
+        dlen = total;
+    } else {
+        /* 2) number of samples containing each d-mer */
+        for (size_t s = 0; s < nsamples; ++s) {
+            for (size_t p = starts[s]; p + DICT_DMER <= starts[s + 1]; ++p) {
+                uint32_t h = dict_dmer_hash(all + p);
+                if (seen[h] != s + 1) { seen[h] = (uint32_t)(s + 1); freq[h]++; }
+            }
+        }
+
+        /* 3) best segment per epoch; d-mers already covered stop counting */
+        size_t nseg = dict_size / DICT_SEGMENT;
+        size_t epoch = total / nseg;
+        if (epoch < DICT_SEGMENT) epoch = DICT_SEGMENT;
+        size_t sample = 0;
+        for (size_t ep = 0; ep + DICT_SEGMENT <= total && dlen + DICT_SEGMENT <= dict_size; ep += epoch) {
+            size_t ep_end = (ep + epoch < total) ? ep + epoch : total;
+            size_t best_pos = 0;
+            uint64_t best_score = 0;
+            for (size_t pos = ep; pos < ep_end; ++pos) {
+                while (sample + 1 < nsamples && starts[sample + 1] <= pos) sample++;
+                if (pos + DICT_SEGMENT > starts[sample + 1]) continue; /* crosses a sample */
+                uint64_t score = 0;
+                for (size_t p = pos; p + DICT_DMER <= pos + DICT_SEGMENT; p += 4) {
+                    uint32_t f = freq[dict_dmer_hash(all + p)];
+                    if (f > 1) score += f - 1;
+                }
+                if (score > best_score) { best_score = score; best_pos = pos; }
+            }
+            if (best_score == 0) continue;
+            memcpy(dict + dlen, all + best_pos, DICT_SEGMENT);
+            dlen += DICT_SEGMENT;
+            for (size_t p = best_pos; p + DICT_DMER <= best_pos + DICT_SEGMENT; ++p) {
+                freq[dict_dmer_hash(all + p)] = 0;
+            }
+        }
+    }
+
+    uint32_t id = dict_fnv1a(dict, dlen);
+    int rc = dict_save(dict_path, dict, dlen, id);
+    if (rc == 0) {
+        printf("[alg_train_dictionary] Diccionario %08x: %zu bytes a partir de %zu muestras (%zu bytes) -> %s\n",
+               id, dlen, nsamples, total, dict_path);
+    }
+    free(dict); free(freq); free(seen); free(all); free(starts);
+    for (size_t i = 0; i < nfiles; ++i) free(files[i]);
+    free(files);
+    return rc;
+
+train_free_files:
+    for (size_t i = 0; i < nfiles; ++i) free(files[i]);
+    free(files);
+    return 1;
+}
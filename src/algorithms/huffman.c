@@ -0,0 +1,244 @@
+#include "../../include/algorithms.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/* =======================================================
+   Canonical Huffman (entropy stage for RLE/LZW/LZSS output)
+   Payload layout:
+     [code lengths: 256 x 4 bits = 128 bytes][bitstream, MSB first]
+   - code lengths are limited to HUFF_MAX_BITS so the decoder can use
+     a single 2^HUFF_MAX_BITS lookup table
+   - each table entry decodes up to two symbols at once
+   - the number of symbols is the original length stored in the header
+   ======================================================= */
+
+#define HUFF_SYMBOLS   256
+#define HUFF_MAX_BITS  11
+#define HUFF_TABLE     (1u << HUFF_MAX_BITS)
+#define HUFF_LEN_BYTES (HUFF_SYMBOLS / 2)
+
+typedef struct {
+    uint8_t sym[2];
+    uint8_t nsym;   /* 0 = invalid code, 1 or 2 symbols */
+    uint8_t len1;   /* bits of the first symbol */
+    uint8_t len;    /* bits of all decoded symbols */
+} HuffEntry;
+
+static int huff_cmp_freq(uint16_t x, uint16_t y, const uint64_t *freq) {
+    if (freq[x] != freq[y]) return freq[x] < freq[y] ? -1 : 1;
+    return (int)x - (int)y;
+}
+
+/* insertion sort of symbol indices by frequency (at most 256 elements) */
+static void huff_sort_symbols(uint16_t *syms, int n, const uint64_t *freq) {
+    for (int i = 1; i < n; ++i) {
+        uint16_t v = syms[i];
+        int j = i - 1;
+        while (j >= 0 && huff_cmp_freq(syms[j], v, freq) > 0) { syms[j + 1] = syms[j]; j--; }
+        syms[j + 1] = v;
+    }
+}
+
+/* Huffman code lengths via the two-queue method; returns the longest length */
+static int huff_build_lengths_once(const uint64_t freq[HUFF_SYMBOLS], uint8_t len[HUFF_SYMBOLS]) {
+    uint16_t leaves[HUFF_SYMBOLS];
+    int n = 0;
+    memset(len, 0, HUFF_SYMBOLS);
+    for (int s = 0; s < HUFF_SYMBOLS; ++s) if (freq[s] > 0) leaves[n++] = (uint16_t)s;
+    if (n == 0) return 0;
+    if (n == 1) { len[leaves[0]] = 1; return 1; }
+    huff_sort_symbols(leaves, n, freq);
+
+    /* nodes 0..n-1 are leaves (sorted), n.. are internal nodes in creation order */
+    uint64_t weight[2 * HUFF_SYMBOLS];
+    int parent[2 * HUFF_SYMBOLS];
+    for (int i = 0; i < n; ++i) weight[i] = freq[leaves[i]];
+
+    int li = 0, ii = n, next = n;
+    for (int k = 0; k < n - 1; ++k) {
+        int pick[2];
+        for (int t = 0; t < 2; ++t) {
+            if (li < n && (ii >= next || weight[li] <= weight[ii])) pick[t] = li++;
+            else pick[t] = ii++;
+        }
+        weight[next] = weight[pick[0]] + weight[pick[1]];
+        parent[pick[0]] = next;
+        parent[pick[1]] = next;
+        next++;
+    }
+
+    int depth[2 * HUFF_SYMBOLS];
+    int root = next - 1;
+    depth[root] = 0;
+    int maxlen = 0;
+    for (int i = root - 1; i >= 0; --i) {
+        depth[i] = depth[parent[i]] + 1;
+        if (i < n) {
+            len[leaves[i]] = (uint8_t)depth[i];
+            if (depth[i] > maxlen) maxlen = depth[i];
+        }
+    }
+    return maxlen;
+}
+
+/* flatten the frequency distribution until every code fits in HUFF_MAX_BITS */
+static void huff_build_lengths(const uint64_t freq_in[HUFF_SYMBOLS], uint8_t len[HUFF_SYMBOLS]) {
+    uint64_t freq[HUFF_SYMBOLS];
+    memcpy(freq, freq_in, sizeof(freq));
+    while (huff_build_lengths_once(freq, len) > HUFF_MAX_BITS) {
+        for (int s = 0; s < HUFF_SYMBOLS; ++s) if (freq[s] > 0) freq[s] = (freq[s] >> 1) | 1;
+    }
+}
+
+/* canonical codes from lengths (DEFLATE ordering); returns 1 if lengths overflow */
+static int huff_assign_codes(const uint8_t len[HUFF_SYMBOLS], uint16_t code[HUFF_SYMBOLS]) {
+    unsigned count[HUFF_MAX_BITS + 1] = {0};
+    unsigned next_code[HUFF_MAX_BITS + 1];
+    for (int s = 0; s < HUFF_SYMBOLS; ++s) {
+        if (len[s] > HUFF_MAX_BITS) return 1;
+        count[len[s]]++;
+    }
+    count[0] = 0;
+    unsigned c = 0, kraft = 0;
+    for (int b = 1; b <= HUFF_MAX_BITS; ++b) {
+        c = (c + count[b - 1]) << 1;
+        next_code[b] = c;
+        kraft += count[b] << (HUFF_MAX_BITS - b);
+    }
+    if (kraft > HUFF_TABLE) return 1;
+    for (int s = 0; s < HUFF_SYMBOLS; ++s) {
+        if (len[s]) code[s] = (uint16_t)next_code[len[s]]++;
+    }
+    return 0;
+}
+
+int alg_compress_huffman_buf(const unsigned char *in, size_t in_len, unsigned char **out, size_t *out_len) {
+    if (!in && in_len > 0) return 1;
+    uint64_t freq[HUFF_SYMBOLS] = {0};
+    for (size_t i = 0; i < in_len; ++i) freq[in[i]]++;
+
+    uint8_t len[HUFF_SYMBOLS];
+    uint16_t code[HUFF_SYMBOLS];
+    huff_build_lengths(freq, len);
+    if (huff_assign_codes(len, code) != 0) return 1;
+
+    size_t cap = HUFF_LEN_BYTES + (in_len / 8) * HUFF_MAX_BITS + HUFF_MAX_BITS + 8;
+    unsigned char *obuf = malloc(cap);
+    if (!obuf) return 1;
+    for (int s = 0; s < HUFF_SYMBOLS; s += 2) obuf[s / 2] = (unsigned char)((len[s] << 4) | len[s + 1]);
+
+    size_t ow = HUFF_LEN_BYTES;
+    uint64_t acc = 0;
+    unsigned nacc = 0;
+    for (size_t i = 0; i < in_len; ++i) {
+        unsigned char s = in[i];
+        acc = (acc << len[s]) | code[s];
+        nacc += len[s];
+        if (nacc >= 32) {
+            while (nacc >= 8) { nacc -= 8; obuf[ow++] = (unsigned char)(acc >> nacc); }
+        }
+    }
+    while (nacc >= 8) { nacc -= 8; obuf[ow++] = (unsigned char)(acc >> nacc); }
+    if (nacc > 0) obuf[ow++] = (unsigned char)(acc << (8 - nacc));
+
+    *out = obuf;
+    *out_len = ow;
+    return 0;
+}
+
+/* builds the two-symbol lookup table; returns 1 if the code lengths are invalid */
+static int huff_build_table(const uint8_t len[HUFF_SYMBOLS], HuffEntry table[HUFF_TABLE]) {
+    uint16_t code[HUFF_SYMBOLS];
+    if (huff_assign_codes(len, code) != 0) return 1;
+
+    uint8_t single_sym[HUFF_TABLE];
+    uint8_t single_len[HUFF_TABLE];
+    memset(single_len, 0, sizeof(single_len));
+    for (int s = 0; s < HUFF_SYMBOLS; ++s) {
+        if (!len[s]) continue;
+        unsigned shift = HUFF_MAX_BITS - len[s];
+        unsigned first = (unsigned)code[s] << shift;
+        for (unsigned k = 0; k < (1u << shift); ++k) {
+            single_sym[first + k] = (uint8_t)s;
+            single_len[first + k] = len[s];
+        }
+    }
+
+    for (unsigned idx = 0; idx < HUFF_TABLE; ++idx) {
+        HuffEntry *e = &table[idx];
+        e->nsym = 0;
+        unsigned l1 = single_len[idx];
+        if (l1 == 0) continue;
+        e->sym[0] = single_sym[idx];
+        e->len1 = (uint8_t)l1;
+        e->len = (uint8_t)l1;
+        e->nsym = 1;
+        unsigned idx2 = (idx << l1) & (HUFF_TABLE - 1);
+        unsigned l2 = single_len[idx2];
+        if (l2 != 0 && l1 + l2 <= HUFF_MAX_BITS) {
+            e->sym[1] = single_sym[idx2];
+            e->len = (uint8_t)(l1 + l2);
+            e->nsym = 2;
+        }
+    }
+    return 0;
+}
+
+int alg_decompress_huffman_buf(const unsigned char *in, size_t in_len, size_t raw_len, unsigned char **out, size_t *out_len) {
+    if (!in || in_len < HUFF_LEN_BYTES) return 1;
+    uint8_t len[HUFF_SYMBOLS];
+    for (int s = 0; s < HUFF_SYMBOLS; s += 2) {
+        len[s] = in[s / 2] >> 4;
+        len[s + 1] = in[s / 2] & 0x0F;
+    }
+
+    HuffEntry *table = malloc(HUFF_TABLE * sizeof(HuffEntry));
+    unsigned char *obuf = malloc(raw_len + 1);
+    if (!table || !obuf) { free(table); free(obuf); return 1; }
+    if (raw_len > 0 && huff_build_table(len, table) != 0) goto huff_decode_fail;
+
+    const unsigned char *ip = in + HUFF_LEN_BYTES;
+    const unsigned char *iend = in + in_len;
+    uint64_t bits = 0;     /* left-aligned bit buffer */
+    unsigned nbits = 0;    /* valid bits in 'bits' */
+    size_t overrun = 0;    /* zero bytes fed past the end of the input */
+    size_t op = 0;
+
+    while (op < raw_len) {
+        /* refill to at least 57 bits: enough for 5 lookups of HUFF_MAX_BITS */
+        while (nbits <= 56) {
+            uint64_t b = 0;
+            if (ip < iend) b = *ip++;
+            else overrun++;
+            bits |= b << (56 - nbits);
+            nbits += 8;
+        }
+        for (int k = 0; k < 5 && op < raw_len; ++k) {
+            const HuffEntry *e = &table[bits >> (64 - HUFF_MAX_BITS)];
+            if (e->nsym == 0) goto huff_decode_fail;
+            obuf[op++] = e->sym[0];
+            if (e->nsym == 2 && op < raw_len) {
+                obuf[op++] = e->sym[1];
+                bits <<= e->len;
+                nbits -= e->len;
+            } else {
+                bits <<= e->len1;
+                nbits -= e->len1;
+            }
+        }
+        if (overrun * 8 > nbits + 64) goto huff_decode_fail;   /* ran far past the end */
+    }
+    /* the consumed bits must lie inside the input */
+    if (overrun * 8 > nbits) goto huff_decode_fail;
+
+    free(table);
+    *out = obuf;
+    *out_len = op;
+    return 0;
+
+huff_decode_fail:
+    free(table);
+    free(obuf);
+    return 1;
+}
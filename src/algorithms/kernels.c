@@ -0,0 +1,296 @@
+#define _POSIX_C_SOURCE 200809L
+#include "../../include/algorithms/kernels.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+/* =======================================================
+   Hot kernels, one variant per ISA level
+   - the SIMD variants are built with per-function target
+     attributes, so the Makefile keeps plain flags and the
+     binary still runs on any x86-64 (or other) host
+   - Feistel decryption of independent blocks runs 4 / 8 / 16
+     blocks side by side: the L and R halves are split into two
+     vectors and every round is add / xor / rotate on all lanes.
+     CBC encryption is sequential by nature and stays scalar.
+   - the lanes are deinterleaved with shuffle_ps and put back with
+     unpacklo/hi, which undo each other's block order
+   ======================================================= */
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+/* -------------------------------------------------------
+   Scalar
+   ------------------------------------------------------- */
+
+static size_t run_length_scalar(const unsigned char *p, size_t n) {
+    size_t i = 1;
+    while (i < n && p[i] == p[0]) i++;
+    return i;
+}
+
+static void xor_bytes_scalar(unsigned char *dst, const unsigned char *a, const unsigned char *b, size_t len) {
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t x, y;
+        memcpy(&x, a + i, 8);
+        memcpy(&y, b + i, 8);
+        x ^= y;
+        memcpy(dst + i, &x, 8);
+    }
+    for (; i < len; ++i) dst[i] = a[i] ^ b[i];
+}
+
+static inline uint32_t load_be32(const unsigned char *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static inline void store_be32(unsigned char *p, uint32_t v) {
+    p[0] = (unsigned char)(v >> 24); p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);  p[3] = (unsigned char)v;
+}
+
+static void feistel_decrypt_blocks_scalar(const uint32_t rk[16], const unsigned char *in, unsigned char *out, size_t nblocks) {
+    for (size_t b = 0; b < nblocks; ++b) {
+        uint32_t L = load_be32(in + 8 * b);
+        uint32_t R = load_be32(in + 8 * b + 4);
+        for (int r = 15; r >= 0; --r) {
+            uint32_t newL = R ^ feistel_round_f(L, rk[r]);
+            R = L;
+            L = newL;
+        }
+        store_be32(out + 8 * b, L);
+        store_be32(out + 8 * b + 4, R);
+    }
+}
+
+#ifdef KERNELS_X86
+
+/* -------------------------------------------------------
+   SSE4.2 (16-byte vectors, 4 Feistel blocks)
+   ------------------------------------------------------- */
+
+__attribute__((target("sse4.2")))
+static size_t run_length_sse42(const unsigned char *p, size_t n) {
+    __m128i v = _mm_set1_epi8((char)p[0]);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        unsigned m = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p + i)), v));
+        if (m != 0xFFFFu) return i + (size_t)__builtin_ctz(~m);
+    }
+    while (i < n && p[i] == p[0]) i++;
+    return i;
+}
+
+__attribute__((target("sse4.2")))
+static void xor_bytes_sse42(unsigned char *dst, const unsigned char *a, const unsigned char *b, size_t len) {
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i x = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(a + i)), _mm_loadu_si128((const __m128i *)(b + i)));
+        _mm_storeu_si128((__m128i *)(dst + i), x);
+    }
+    xor_bytes_scalar(dst + i, a + i, b + i, len - i);
+}
+
+#define ROL128(x, s) _mm_or_si128(_mm_slli_epi32((x), (s)), _mm_srli_epi32((x), 32 - (s)))
+
+__attribute__((target("sse4.2")))
+static void feistel_decrypt_blocks_sse42(const uint32_t rk[16], const unsigned char *in, unsigned char *out, size_t nblocks) {
+    const __m128i bswap = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    size_t b = 0;
+    for (; b + 4 <= nblocks; b += 4) {
+        __m128i x0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(in + 8 * b)), bswap);
+        __m128i x1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(in + 8 * b + 16)), bswap);
+        __m128i L = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(x0), _mm_castsi128_ps(x1), _MM_SHUFFLE(2, 0, 2, 0)));
+        __m128i R = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(x0), _mm_castsi128_ps(x1), _MM_SHUFFLE(3, 1, 3, 1)));
+        for (int r = 15; r >= 0; --r) {
+            __m128i k = _mm_set1_epi32((int)rk[r]);
+            __m128i f = _mm_add_epi32(L, k);
+            f = _mm_xor_si128(f, ROL128(L, 5));
+            f = _mm_add_epi32(f, _mm_set1_epi32((int)(rk[r] ^ 0xA5A5A5A5u)));
+            f = ROL128(f, 11);
+            f = _mm_xor_si128(f, _mm_set1_epi32((int)(rk[r] >> 3)));
+            __m128i newL = _mm_xor_si128(R, f);
+            R = L;
+            L = newL;
+        }
+        _mm_storeu_si128((__m128i *)(out + 8 * b), _mm_shuffle_epi8(_mm_unpacklo_epi32(L, R), bswap));
+        _mm_storeu_si128((__m128i *)(out + 8 * b + 16), _mm_shuffle_epi8(_mm_unpackhi_epi32(L, R), bswap));
+    }
+    feistel_decrypt_blocks_scalar(rk, in + 8 * b, out + 8 * b, nblocks - b);
+}
+
+/* -------------------------------------------------------
+   AVX2 (32-byte vectors, 8 Feistel blocks)
+   ------------------------------------------------------- */
+
+__attribute__((target("avx2")))
+static size_t run_length_avx2(const unsigned char *p, size_t n) {
+    __m256i v = _mm256_set1_epi8((char)p[0]);
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        unsigned m = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p + i)), v));
+        if (m != 0xFFFFFFFFu) return i + (size_t)__builtin_ctz(~m);
+    }
+    while (i < n && p[i] == p[0]) i++;
+    return i;
+}
+
+__attribute__((target("avx2")))
+static void xor_bytes_avx2(unsigned char *dst, const unsigned char *a, const unsigned char *b, size_t len) {
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i x = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(a + i)), _mm256_loadu_si256((const __m256i *)(b + i)));
+        _mm256_storeu_si256((__m256i *)(dst + i), x);
+    }
+    xor_bytes_scalar(dst + i, a + i, b + i, len - i);
+}
+
+#define ROL256(x, s) _mm256_or_si256(_mm256_slli_epi32((x), (s)), _mm256_srli_epi32((x), 32 - (s)))
+
+__attribute__((target("avx2")))
+static void feistel_decrypt_blocks_avx2(const uint32_t rk[16], const unsigned char *in, unsigned char *out, size_t nblocks) {
+    const __m256i bswap = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                           3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    size_t b = 0;
+    for (; b + 8 <= nblocks; b += 8) {
+        __m256i x0 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(in + 8 * b)), bswap);
+        __m256i x1 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(in + 8 * b + 32)), bswap);
+        __m256i L = _mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(x0), _mm256_castsi256_ps(x1), _MM_SHUFFLE(2, 0, 2, 0)));
+        __m256i R = _mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(x0), _mm256_castsi256_ps(x1), _MM_SHUFFLE(3, 1, 3, 1)));
+        for (int r = 15; r >= 0; --r) {
+            __m256i f = _mm256_add_epi32(L, _mm256_set1_epi32((int)rk[r]));
+            f = _mm256_xor_si256(f, ROL256(L, 5));
+            f = _mm256_add_epi32(f, _mm256_set1_epi32((int)(rk[r] ^ 0xA5A5A5A5u)));
+            f = ROL256(f, 11);
+            f = _mm256_xor_si256(f, _mm256_set1_epi32((int)(rk[r] >> 3)));
+            __m256i newL = _mm256_xor_si256(R, f);
+            R = L;
+            L = newL;
+        }
+        _mm256_storeu_si256((__m256i *)(out + 8 * b), _mm256_shuffle_epi8(_mm256_unpacklo_epi32(L, R), bswap));
+        _mm256_storeu_si256((__m256i *)(out + 8 * b + 32), _mm256_shuffle_epi8(_mm256_unpackhi_epi32(L, R), bswap));
+    }
+    feistel_decrypt_blocks_sse42(rk, in + 8 * b, out + 8 * b, nblocks - b);
+}
+
+/* -------------------------------------------------------
+   AVX-512 (F + BW: 64-byte vectors, 16 Feistel blocks)
+   ------------------------------------------------------- */
+
+__attribute__((target("avx512f,avx512bw")))
+static size_t run_length_avx512(const unsigned char *p, size_t n) {
+    __m512i v = _mm512_set1_epi8((char)p[0]);
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        uint64_t m = _mm512_cmpeq_epi8_mask(_mm512_loadu_si512((const void *)(p + i)), v);
+        if (m != UINT64_MAX) return i + (size_t)__builtin_ctzll(~m);
+    }
+    while (i < n && p[i] == p[0]) i++;
+    return i;
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void xor_bytes_avx512(unsigned char *dst, const unsigned char *a, const unsigned char *b, size_t len) {
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64) {
+        __m512i x = _mm512_xor_si512(_mm512_loadu_si512((const void *)(a + i)), _mm512_loadu_si512((const void *)(b + i)));
+        _mm512_storeu_si512((void *)(dst + i), x);
+    }
+    xor_bytes_avx2(dst + i, a + i, b + i, len - i);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void feistel_decrypt_blocks_avx512(const uint32_t rk[16], const unsigned char *in, unsigned char *out, size_t nblocks) {
+    const __m512i bswap = _mm512_set4_epi32(0x0C0D0E0F, 0x08090A0B, 0x04050607, 0x00010203);
+    size_t b = 0;
+    for (; b + 16 <= nblocks; b += 16) {
+        __m512i x0 = _mm512_shuffle_epi8(_mm512_loadu_si512((const void *)(in + 8 * b)), bswap);
+        __m512i x1 = _mm512_shuffle_epi8(_mm512_loadu_si512((const void *)(in + 8 * b + 64)), bswap);
+        __m512i L = _mm512_castps_si512(_mm512_shuffle_ps(_mm512_castsi512_ps(x0), _mm512_castsi512_ps(x1), _MM_SHUFFLE(2, 0, 2, 0)));
+        __m512i R = _mm512_castps_si512(_mm512_shuffle_ps(_mm512_castsi512_ps(x0), _mm512_castsi512_ps(x1), _MM_SHUFFLE(3, 1, 3, 1)));
+        for (int r = 15; r >= 0; --r) {
+            __m512i f = _mm512_add_epi32(L, _mm512_set1_epi32((int)rk[r]));
+            f = _mm512_xor_si512(f, _mm512_rol_epi32(L, 5));
+            f = _mm512_add_epi32(f, _mm512_set1_epi32((int)(rk[r] ^ 0xA5A5A5A5u)));
+            f = _mm512_rol_epi32(f, 11);
+            f = _mm512_xor_si512(f, _mm512_set1_epi32((int)(rk[r] >> 3)));
+            __m512i newL = _mm512_xor_si512(R, f);
+            R = L;
+            L = newL;
+        }
+        _mm512_storeu_si512((void *)(out + 8 * b), _mm512_shuffle_epi8(_mm512_unpacklo_epi32(L, R), bswap));
+        _mm512_storeu_si512((void *)(out + 8 * b + 64), _mm512_shuffle_epi8(_mm512_unpackhi_epi32(L, R), bswap));
+    }
+    feistel_decrypt_blocks_avx2(rk, in + 8 * b, out + 8 * b, nblocks - b);
+}
+
+#endif /* KERNELS_X86 */
+
+/* -------------------------------------------------------
+   Dispatch
+   ------------------------------------------------------- */
+
+static const Kernels kernel_variants[] = {
+    { "scalar", run_length_scalar, xor_bytes_scalar, feistel_decrypt_blocks_scalar },
+#ifdef KERNELS_X86
+    { "sse4.2", run_length_sse42, xor_bytes_sse42, feistel_decrypt_blocks_sse42 },
+    { "avx2",   run_length_avx2,  xor_bytes_avx2,  feistel_decrypt_blocks_avx2 },
+    { "avx512", run_length_avx512, xor_bytes_avx512, feistel_decrypt_blocks_avx512 },
+#endif
+};
+
+static int kernels_supported;   /* variants 0..kernels_supported-1 run on this CPU */
+static const Kernels *kernels_active;
+static pthread_once_t kernels_once = PTHREAD_ONCE_INIT;
+
+static void kernels_select(void) {
+    kernels_supported = 1;
+#ifdef KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("ssse3")) {
+        kernels_supported = 2;
+        if (__builtin_cpu_supports("avx2")) {
+            kernels_supported = 3;
+            if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) kernels_supported = 4;
+        }
+    }
+#endif
+    int pick = kernels_supported - 1;
+    const char *env = getenv("GSEA_ISA");
+    if (env && *env) {
+        int want = -1;
+        int total = (int)(sizeof(kernel_variants) / sizeof(kernel_variants[0]));
+        for (int i = 0; i < total; ++i) {
+            if (strcmp(env, kernel_variants[i].name) == 0) want = i;
+        }
+        if (want < 0) {
+            fprintf(stderr, "[kernels] GSEA_ISA=%s desconocido, se usa %s\n", env, kernel_variants[pick].name);
+        } else if (want > pick) {
+            fprintf(stderr, "[kernels] la CPU no soporta %s, se usa %s\n", env, kernel_variants[pick].name);
+        } else {
+            pick = want;
+        }
+    }
+    kernels_active = &kernel_variants[pick];
+}
+
+const Kernels *kernels(void) {
+    pthread_once(&kernels_once, kernels_select);
+    return kernels_active;
+}
+
+int kernels_variant_count(void) {
+    pthread_once(&kernels_once, kernels_select);
+    return kernels_supported;
+}
+
+const Kernels *kernels_variant(int i) {
+    if (i < 0 || i >= kernels_variant_count()) return NULL;
+    return &kernel_variants[i];
+}
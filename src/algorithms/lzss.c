@@ -0,0 +1,283 @@
+#include "../../include/algorithms.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/* =======================================================
+   LZSS (LZ4-class block format) with hash-chain match finder
+   Sequence layout:
+     [token:1byte] hi nibble = literal length, lo nibble = match length - 4
+     (a nibble of 15 means "more length bytes follow": 255,255,..,<255)
+     [literals][offset:2 bytes LE][extra match length bytes]
+   The last sequence carries only literals (input ends right after them).
+   - window: 1 << window_bits bytes (10..16), offsets fit in 16 bits
+   - levels 1..4: greedy parsing, 5..9: lazy parsing (one step lookahead)
+   - an optional trained dictionary acts as history before the input:
+     offsets may point back into it
+   ======================================================= */
+
+#define LZSS_MIN_MATCH   4
+#define LZSS_HASH_BITS   16
+#define LZSS_HASH_SIZE   (1u << LZSS_HASH_BITS)
+#define LZSS_NIL         ((size_t)-1)
+#define LZSS_WILDCOPY    16   /* slack at the end of the decode buffer for 8-byte copies */
+
+typedef struct {
+    int chain;   /* candidates inspected per position */
+    int lazy;    /* 1 -> try pos+1 before committing a match */
+} LZSSLevel;
+
+static const LZSSLevel lzss_levels[10] = {
+    {  0, 0 },   /* unused */
+    {  1, 0 }, {  4, 0 }, {  8, 0 }, { 16, 0 },
+    { 16, 1 }, { 32, 1 }, { 64, 1 }, { 128, 1 }, { 256, 1 }
+};
+
+typedef struct {
+    const unsigned char *buf;
+    size_t len;
+    size_t window_mask;
+    size_t max_dist;
+    size_t next_insert;   /* first position not yet inserted in the chains */
+    size_t *head;         /* hash -> most recent position */
+    size_t *prev;         /* position & window_mask -> previous position with same hash */
+} LZSSMatcher;
+
+static inline uint32_t lzss_read32(const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static inline uint32_t lzss_hash(const unsigned char *p) {
+    return (lzss_read32(p) * 2654435761u) >> (32 - LZSS_HASH_BITS);
+}
+
+/* insert every position in [next_insert, limit) into the hash chains */
+static void lzss_insert_upto(LZSSMatcher *m, size_t limit) {
+    if (limit + LZSS_MIN_MATCH > m->len) {
+        limit = (m->len >= LZSS_MIN_MATCH) ? m->len - LZSS_MIN_MATCH + 1 : 0;
+    }
+    for (size_t p = m->next_insert; p < limit; ++p) {
+        uint32_t h = lzss_hash(m->buf + p);
+        m->prev[p & m->window_mask] = m->head[h];
+        m->head[h] = p;
+    }
+    if (limit > m->next_insert) m->next_insert = limit;
+}
+
+static size_t lzss_match_len(const unsigned char *a, const unsigned char *b, const unsigned char *end) {
+    const unsigned char *start = a;
+    while (a + 8 <= end) {
+        uint64_t x, y;
+        memcpy(&x, a, 8);
+        memcpy(&y, b, 8);
+        if (x != y) break;
+        a += 8; b += 8;
+    }
+    while (a < end && *a == *b) { a++; b++; }
+    return (size_t)(a - start);
+}
+
+/* longest match for position pos; returns length (0 if < LZSS_MIN_MATCH) */
+static size_t lzss_find(LZSSMatcher *m, size_t pos, int chain, size_t *offset) {
+    if (pos + LZSS_MIN_MATCH > m->len) return 0;
+    lzss_insert_upto(m, pos);
+
+    const unsigned char *cur = m->buf + pos;
+    const unsigned char *end = m->buf + m->len;
+    size_t best = 0;
+    size_t cand = m->head[lzss_hash(cur)];
+
+    while (cand != LZSS_NIL && chain-- > 0) {
+        if (cand >= pos || pos - cand > m->max_dist) break;
+        const unsigned char *c = m->buf + cand;
+        if (c[best] == cur[best] && lzss_read32(c) == lzss_read32(cur)) {
+            size_t len = LZSS_MIN_MATCH + lzss_match_len(cur + LZSS_MIN_MATCH, c + LZSS_MIN_MATCH, end);
+            if (len > best) {
+                best = len;
+                *offset = pos - cand;
+                if (cur + best >= end) break;
+            }
+        }
+        size_t next = m->prev[cand & m->window_mask];
+        if (next >= cand) break;
+        cand = next;
+    }
+    return (best >= LZSS_MIN_MATCH) ? best : 0;
+}
+
+static unsigned char *lzss_put_len(unsigned char *op, size_t len) {
+    while (len >= 255) { *op++ = 255; len -= 255; }
+    *op++ = (unsigned char)len;
+    return op;
+}
+
+/* emit [token][literals] and, if mlen > 0, [offset][match length] */
+static unsigned char *lzss_emit(unsigned char *op, const unsigned char *lit, size_t lit_len, size_t offset, size_t mlen) {
+    unsigned char *token = op++;
+    size_t ml = (mlen > 0) ? mlen - LZSS_MIN_MATCH : 0;
+    *token = (unsigned char)(((lit_len < 15 ? lit_len : 15) << 4) | (ml < 15 ? ml : 15));
+    if (lit_len >= 15) op = lzss_put_len(op, lit_len - 15);
+    memcpy(op, lit, lit_len);
+    op += lit_len;
+    if (mlen == 0) return op;
+    *op++ = (unsigned char)(offset & 0xFF);
+    *op++ = (unsigned char)(offset >> 8);
+    if (ml >= 15) op = lzss_put_len(op, ml - 15);
+    return op;
+}
+
+size_t alg_lzss_bound(size_t in_len) {
+    return in_len + in_len / 255 + 16;
+}
+
+int alg_compress_lzss_buf(const unsigned char *dict, size_t dict_len, const unsigned char *in, size_t in_len, int level, int window_bits, unsigned char **out, size_t *out_len) {
+    if (!in && in_len > 0) return 1;
+    if (level < 1) level = ALG_LZSS_DEFAULT_LEVEL;
+    if (level > 9) level = 9;
+    if (window_bits < ALG_LZSS_MIN_WINDOW_BITS || window_bits > ALG_LZSS_MAX_WINDOW_BITS) window_bits = ALG_LZSS_MAX_WINDOW_BITS;
+
+    size_t window = (size_t)1 << window_bits;
+    if (!dict) dict_len = 0;
+    if (dict_len > window - 1) {
+        /* only the tail of the dictionary is reachable */
+        dict += dict_len - (window - 1);
+        dict_len = window - 1;
+    }
+
+    /* the matcher works on one contiguous buffer: [dictionary][input] */
+    const unsigned char *base = in;
+    unsigned char *joined = NULL;
+    if (dict_len > 0) {
+        joined = malloc(dict_len + in_len);
+        if (!joined) return 1;
+        memcpy(joined, dict, dict_len);
+        if (in_len > 0) memcpy(joined + dict_len, in, in_len);
+        base = joined;
+    }
+
+    unsigned char *obuf = malloc(alg_lzss_bound(in_len));
+    if (!obuf) { free(joined); return 1; }
+
+    LZSSMatcher m;
+    m.buf = base;
+    m.len = dict_len + in_len;
+    m.window_mask = window - 1;
+    m.max_dist = window - 1;
+    m.next_insert = 0;
+    m.head = malloc(LZSS_HASH_SIZE * sizeof(size_t));
+    m.prev = malloc(window * sizeof(size_t));
+    if (!m.head || !m.prev) { free(m.head); free(m.prev); free(obuf); free(joined); return 1; }
+    for (size_t i = 0; i < LZSS_HASH_SIZE; ++i) m.head[i] = LZSS_NIL;
+
+    const LZSSLevel *lv = &lzss_levels[level];
+    unsigned char *op = obuf;
+    size_t end = m.len;
+    size_t anchor = dict_len, pos = dict_len;
+
+    while (pos + LZSS_MIN_MATCH <= end) {
+        size_t off = 0;
+        size_t mlen = lzss_find(&m, pos, lv->chain, &off);
+        if (mlen == 0) { pos++; continue; }
+
+        /* lazy evaluation: prefer a longer match starting one byte later */
+        while (lv->lazy && pos + 1 + LZSS_MIN_MATCH <= end) {
+            size_t off2 = 0;
+            size_t mlen2 = lzss_find(&m, pos + 1, lv->chain, &off2);
+            if (mlen2 <= mlen) break;
+            pos++;
+            mlen = mlen2;
+            off = off2;
+        }
+
+        op = lzss_emit(op, base + anchor, pos - anchor, off, mlen);
+        pos += mlen;
+        anchor = pos;
+    }
+    op = lzss_emit(op, base + anchor, end - anchor, 0, 0);
+
+    free(m.head);
+    free(m.prev);
+    free(joined);
+    *out = obuf;
+    *out_len = (size_t)(op - obuf);
+    return 0;
+}
+
+/* reads a 255-continued length; returns 0 on truncated input */
+static int lzss_get_len(const unsigned char **ip, const unsigned char *iend, size_t limit, size_t *len) {
+    unsigned char b;
+    do {
+        if (*ip >= iend) return 0;
+        b = *(*ip)++;
+        *len += b;
+        if (*len > limit) return 0;
+    } while (b == 255);
+    return 1;
+}
+
+int alg_decompress_lzss_buf(const unsigned char *dict, size_t dict_len, const unsigned char *in, size_t in_len, size_t raw_len, unsigned char **out, size_t *out_len) {
+    if (!in && in_len > 0) return 1;
+    if (!dict) dict_len = 0;
+    unsigned char *obuf = malloc(raw_len + LZSS_WILDCOPY);
+    if (!obuf) return 1;
+
+    const unsigned char *ip = in;
+    const unsigned char *iend = in + in_len;
+    size_t op = 0;
+
+    for (;;) {
+        if (ip >= iend) goto lzss_decode_fail;
+        unsigned char token = *ip++;
+
+        size_t lit = token >> 4;
+        if (lit == 15 && !lzss_get_len(&ip, iend, raw_len, &lit)) goto lzss_decode_fail;
+        if (lit > (size_t)(iend - ip) || lit > raw_len - op) goto lzss_decode_fail;
+        memcpy(obuf + op, ip, lit);
+        ip += lit;
+        op += lit;
+        if (ip == iend) break;   /* last sequence: literals only */
+
+        if (iend - ip < 2) goto lzss_decode_fail;
+        size_t off = (size_t)ip[0] | ((size_t)ip[1] << 8);
+        ip += 2;
+        if (off == 0 || off > op + dict_len) goto lzss_decode_fail;
+
+        size_t mlen = token & 15;
+        if (mlen == 15 && !lzss_get_len(&ip, iend, raw_len, &mlen)) goto lzss_decode_fail;
+        mlen += LZSS_MIN_MATCH;
+        if (mlen > raw_len - op) goto lzss_decode_fail;
+
+        unsigned char *d = obuf + op;
+        if (off > op) {
+            /* match starts inside the dictionary and may continue into the output */
+            const unsigned char *ds = dict + dict_len - (off - op);
+            size_t from_dict = off - op;
+            if (from_dict > mlen) from_dict = mlen;
+            memcpy(d, ds, from_dict);
+            for (size_t k = from_dict; k < mlen; ++k) d[k] = obuf[k - from_dict];
+        } else {
+            const unsigned char *s = d - off;
+            if (off >= mlen) {
+                memcpy(d, s, mlen);
+            } else if (off >= 8) {
+                /* overlapping but at least 8 apart: 8-byte steps, may spill into the slack */
+                unsigned char *e = d + mlen;
+                do { memcpy(d, s, 8); d += 8; s += 8; } while (d < e);
+            } else {
+                for (size_t k = 0; k < mlen; ++k) d[k] = s[k];
+            }
+        }
+        op += mlen;
+    }
+
+    if (op != raw_len) goto lzss_decode_fail;
+    *out = obuf;
+    *out_len = op;
+    return 0;
+
+lzss_decode_fail:
+    free(obuf);
+    return 1;
+}
@@ -0,0 +1,312 @@
+#define _POSIX_C_SOURCE 200809L
+#include "../../include/algorithms.h"
+#include "../../include/file.h"
+#include "../../include/algorithms/container.h"
+#include "../../include/algorithms/stream.h"
+#include "../../include/trace.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+/* =======================================================
+   Range extraction (--range start:len)
+   - the source is the file itself or, when encrypted, its CBC
+     plaintext: CBC only chains on the encrypt side, so cipher block
+     i decrypts with block i-1 as IV and any slice can be read
+     by fetching one extra block in front of it; the key-check value
+     in the cipher header rejects a wrong key before any of that
+   - seekable containers (frames + index, see container.h) locate
+     the first frame with a binary search over the index; framed
+     containers without index hop from frame header to frame
+     header; only the frames that overlap the range are decoded
+   - anything else (single block, Huffman-wrapped, legacy) is
+     decoded whole and sliced: correct, but not proportional
+   ======================================================= */
+
+#define RANGE_COPY_CHUNK (1024 * 1024)
+
+typedef struct {
+    int fd;
+    uint64_t size;           /* plaintext size */
+    const FeistelKey *fk;    /* NULL: plain file */
+    uint64_t iv_off;         /* file offset of the IV (cipher header length - 8) */
+} RangeSource;
+
+static uint64_t get_u64(const unsigned char *p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; ++i) v |= (uint64_t)p[i] << (8 * i);
+    return v;
+}
+
+static uint32_t get_u32(const unsigned char *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static int range_source_open(RangeSource *src, int fd, const FeistelKey *fk) {
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        perror("[range] fstat");
+        return 1;
+    }
+    src->fd = fd;
+    src->fk = fk;
+    src->iv_off = 0;
+    src->size = (uint64_t)st.st_size;
+    if (!fk) return 0;
+
+    unsigned char hdr[FEISTEL_HEADER_LEN];
+    ssize_t got = safe_pread(fd, hdr, sizeof(hdr), 0);
+    uint8_t hdr_iv[8];
+    size_t hdr_len;
+    if (got < 0 || feistel_read_header(fk, hdr, (size_t)got, hdr_iv, &hdr_len) != 0) return 1;
+    src->iv_off = hdr_len - 8;
+
+    /* header + at least one block; the padding is in the last block */
+    if (src->size < hdr_len + 8 || (src->size - hdr_len) % 8 != 0) {
+        fprintf(stderr, "[range] texto cifrado mal formado\n");
+        return 1;
+    }
+    unsigned char tail[16];
+    if (safe_pread(fd, tail, 16, src->size - 16) != 16) return 1;
+    uint8_t iv[8];
+    memcpy(iv, tail, 8);
+    feistel_cbc_decrypt(fk, iv, tail + 8, tail + 8, 8);
+    size_t pad;
+    if (feistel_unpad(tail + 8, &pad) != 0) {
+        fprintf(stderr, "[range] padding invalido (clave incorrecta?)\n");
+        return 1;
+    }
+    src->size -= hdr_len + pad;
+    return 0;
+}
+
+/* n plaintext bytes at off (off + n <= size) */
+static int range_read(const RangeSource *src, uint64_t off, unsigned char *out, size_t n) {
+    if (n == 0) return 0;
+    if (off > src->size || n > src->size - off) return 1;
+    if (!src->fk) return safe_pread(src->fd, out, n, off) != (ssize_t)n;
+
+    uint64_t first = off / 8, last = (off + n - 1) / 8;
+    size_t span = (size_t)(last - first + 1) * 8;
+    unsigned char *buf = malloc(span + 8);
+    if (!buf) { perror("[range] malloc"); return 1; }
+    /* file offset of cipher block b is iv_off + 8 + 8b; block first-1 (or the IV) is its IV */
+    int rc = safe_pread(src->fd, buf, span + 8, src->iv_off + first * 8) != (ssize_t)(span + 8);
+    if (rc == 0) {
+        uint8_t iv[8];
+        memcpy(iv, buf, 8);
+        trace_begin("feistel", NULL);
+        feistel_cbc_decrypt(src->fk, iv, buf + 8, buf + 8, span);
+        trace_end();
+        memcpy(out, buf + 8 + (off % 8), n);
+    }
+    free(buf);
+    return rc;
+}
+
+/* copies plaintext [start, start + len) to out_fd */
+static int range_copy(const RangeSource *src, uint64_t start, uint64_t len, int out_fd) {
+    unsigned char *buf = malloc(RANGE_COPY_CHUNK);
+    if (!buf) return 1;
+    int rc = 0;
+    while (rc == 0 && len > 0) {
+        size_t n = len < RANGE_COPY_CHUNK ? (size_t)len : RANGE_COPY_CHUNK;
+        rc = range_read(src, start, buf, n) || safe_write(out_fd, buf, n) != 0;
+        start += n;
+        len -= n;
+    }
+    free(buf);
+    return rc;
+}
+
+static int range_write_zeros(int out_fd, uint64_t len) {
+    static const unsigned char zeros[STREAM_CHUNK];
+    while (len > 0) {
+        size_t n = len < sizeof(zeros) ? (size_t)len : sizeof(zeros);
+        if (safe_write(out_fd, zeros, n) != 0) return 1;
+        len -= n;
+    }
+    return 0;
+}
+
+/* -------------------------------------------------------
+   Whole decode + slice (containers without frames)
+   ------------------------------------------------------- */
+
+typedef struct {
+    int fd;
+    uint64_t skip, left;
+} SliceSink;
+
+static int slice_sink(void *ctx, const unsigned char *buf, size_t len) {
+    SliceSink *s = ctx;
+    if (s->skip >= len) { s->skip -= len; return 0; }
+    buf += s->skip;
+    len -= (size_t)s->skip;
+    s->skip = 0;
+    if (len > s->left) len = (size_t)s->left;
+    s->left -= len;
+    return len ? safe_write(s->fd, buf, len) != 0 : 0;
+}
+
+static int range_decode_whole(const RangeSource *src, const CompressOptions *opts, uint64_t start, uint64_t len, int out_fd) {
+    StreamStage *st = stream_decompress_new(opts);
+    unsigned char *buf = malloc(RANGE_COPY_CHUNK);
+    int rc = !st || !buf;
+    SliceSink sink = { out_fd, start, len };
+    if (rc == 0) stream_set_sink(st, slice_sink, &sink);
+    for (uint64_t off = 0; rc == 0 && off < src->size && sink.left > 0; ) {
+        size_t n = src->size - off < RANGE_COPY_CHUNK ? (size_t)(src->size - off) : RANGE_COPY_CHUNK;
+        rc = range_read(src, off, buf, n) || stream_push(st, buf, n);
+        off += n;
+    }
+    /* stopping early skips the final checks, which is fine for a slice */
+    if (rc == 0 && sink.left > 0) rc = stream_finish(st);
+    stream_free(st);
+    free(buf);
+    return rc;
+}
+
+/* -------------------------------------------------------
+   Framed containers
+   ------------------------------------------------------- */
+
+/* loads the index if the container ends with a valid one */
+static unsigned char *range_load_index(const RangeSource *src, size_t hdr_len, uint32_t *count, uint64_t *raw_total) {
+    if (src->size < hdr_len + GSZ_FRAME_HEADER_LEN + GSZ_INDEX_TRAILER_LEN) return NULL;
+    unsigned char tr[GSZ_INDEX_TRAILER_LEN];
+    if (range_read(src, src->size - GSZ_INDEX_TRAILER_LEN, tr, sizeof(tr)) != 0) return NULL;
+    if (memcmp(tr + 20, GSZ_INDEX_MAGIC, 4) != 0) return NULL;
+    uint64_t index_off = get_u64(tr);
+    uint32_t n = get_u32(tr + 16);
+    if (index_off < hdr_len || index_off > src->size - GSZ_INDEX_TRAILER_LEN ||
+        (uint64_t)n * GSZ_INDEX_ENTRY_LEN != src->size - GSZ_INDEX_TRAILER_LEN - index_off) return NULL;
+    unsigned char *index = malloc((size_t)n * GSZ_INDEX_ENTRY_LEN + 1);
+    if (!index) return NULL;
+    if (range_read(src, index_off, index, (size_t)n * GSZ_INDEX_ENTRY_LEN) != 0) { free(index); return NULL; }
+    *count = n;
+    *raw_total = get_u64(tr + 8);
+    return index;
+}
+
+/* decodes the frame at file offset pos (raw offset raw_pos) and writes the
+   part inside [start, end); *next_pos / *next_raw point past it */
+static int range_frame(const RangeSource *src, CompressionAlgorithm alg, const CompressDict *dict,
+                       uint64_t pos, uint64_t raw_pos, uint64_t start, uint64_t end, int out_fd,
+                       uint64_t *next_pos, uint64_t *next_raw, int *is_end) {
+    unsigned char fh[GSZ_HOLE_FRAME_LEN];
+    if (range_read(src, pos, fh, GSZ_FRAME_HEADER_LEN) != 0) return 1;
+    uint32_t raw = get_u32(fh), comp = get_u32(fh + 4);
+    *is_end = raw == 0 && comp == 0;
+    if (*is_end) return 0;
+
+    uint64_t raw_len = raw;
+    uint64_t frame_len = GSZ_FRAME_HEADER_LEN + (uint64_t)comp;
+    int hole = raw == 0 && comp == GSZ_FRAME_HOLE;
+    if (hole) {
+        if (range_read(src, pos + 8, fh + 8, 8) != 0) return 1;
+        raw_len = get_u64(fh + 8);
+        frame_len = GSZ_HOLE_FRAME_LEN;
+    } else if (raw > GSZ_FRAME_MAX_RAW || comp > 2 * (size_t)GSZ_FRAME_MAX_RAW + 1024) {
+        fprintf(stderr, "[range] trama corrupta\n");
+        return 1;
+    }
+    *next_pos = pos + frame_len;
+    *next_raw = raw_pos + raw_len;
+
+    uint64_t lo = start > raw_pos ? start : raw_pos;
+    uint64_t hi = end < raw_pos + raw_len ? end : raw_pos + raw_len;
+    if (lo >= hi) return 0;
+    if (hole) return range_write_zeros(out_fd, hi - lo);
+
+    unsigned char *in = malloc(comp ? comp : 1);
+    if (!in) return 1;
+    unsigned char *out = NULL;
+    size_t out_len = 0;
+    int rc = range_read(src, pos + GSZ_FRAME_HEADER_LEN, in, comp);
+    if (rc == 0) rc = gsz_decode_block(alg, dict, in, comp, raw, &out, &out_len);
+    if (rc == 0 && out_len != raw) rc = 1;
+    if (rc == 0) rc = safe_write(out_fd, out + (lo - raw_pos), (size_t)(hi - lo)) != 0;
+    free(in);
+    free(out);
+    return rc;
+}
+
+static int range_decode_frames(const RangeSource *src, size_t hdr_len, CompressionAlgorithm alg, const CompressDict *dict,
+                               uint64_t start, uint64_t len, int out_fd) {
+    uint64_t end = len > UINT64_MAX - start ? UINT64_MAX : start + len;
+    uint64_t pos = hdr_len, raw_pos = 0;
+
+    uint32_t count = 0;
+    uint64_t raw_total = 0;
+    unsigned char *index = range_load_index(src, hdr_len, &count, &raw_total);
+    if (index) {
+        if (start >= raw_total || count == 0) { free(index); return 0; }
+        /* last entry with raw offset <= start */
+        uint32_t lo = 0, hi = count - 1;
+        while (lo < hi) {
+            uint32_t mid = lo + (hi - lo + 1) / 2;
+            if (get_u64(index + (size_t)mid * GSZ_INDEX_ENTRY_LEN) <= start) lo = mid;
+            else hi = mid - 1;
+        }
+        raw_pos = get_u64(index + (size_t)lo * GSZ_INDEX_ENTRY_LEN);
+        pos = get_u64(index + (size_t)lo * GSZ_INDEX_ENTRY_LEN + 8);
+        free(index);
+    }
+
+    int rc = 0;
+    while (rc == 0 && raw_pos < end) {
+        int is_end = 0;
+        uint64_t next_pos = pos, next_raw = raw_pos;
+        trace_begin("frame", NULL);
+        rc = range_frame(src, alg, dict, pos, raw_pos, start, end, out_fd, &next_pos, &next_raw, &is_end);
+        trace_end();
+        if (is_end) break;
+        pos = next_pos;
+        raw_pos = next_raw;
+    }
+    return rc;
+}
+
+/* -------------------------------------------------------
+   Entry point
+   ------------------------------------------------------- */
+
+static int extract_range(const char *in_path, int out_fd, int decompress, const FeistelKey *fk, const CompressOptions *opts, uint64_t start, uint64_t len) {
+    int fd = safe_open(in_path, O_RDONLY, 0);
+    if (fd < 0) return 1;
+    RangeSource src;
+    int rc = range_source_open(&src, fd, fk);
+    if (rc == 0 && !decompress) {
+        if (start < src.size) {
+            if (len > src.size - start) len = src.size - start;
+            rc = range_copy(&src, start, len, out_fd);
+        }
+    } else if (rc == 0) {
+        unsigned char hdr[GSZ_HEADER_MAX_LEN];
+        size_t got = src.size < sizeof(hdr) ? (size_t)src.size : sizeof(hdr);
+        CompressionAlgorithm alg = 0;
+        uint64_t raw_len = 0;
+        uint32_t dict_id = 0;
+        size_t hdr_len = 0;
+        const CompressDict *dict = NULL;
+        if (range_read(&src, 0, hdr, got) != 0) rc = 1;
+        if (rc == 0) hdr_len = gsz_read_header(hdr, got, &alg, &raw_len, &dict_id, NULL);
+        if (rc == 0 && hdr_len > 0 && alg != ALG_HUFFMAN && raw_len == GSZ_RAW_FRAMED) {
+            rc = gsz_check_dict(dict_id, opts ? opts->dict : NULL, &dict);
+            if (rc == 0) rc = range_decode_frames(&src, hdr_len, alg, dict, start, len, out_fd);
+        } else if (rc == 0) {
+            rc = range_decode_whole(&src, opts, start, len, out_fd);
+        }
+    }
+    safe_close(fd);
+    return rc;
+}
+
+int alg_extract_range(const char *in_path, int out_fd, int decompress, const FeistelKey *fk, const CompressOptions *opts, uint64_t start, uint64_t len) {
+    trace_begin("alg_extract_range", in_path);
+    int rc = extract_range(in_path, out_fd, decompress, fk, opts, start, len);
+    trace_end();
+    return rc;
+}
@@ -0,0 +1,693 @@
+#define _POSIX_C_SOURCE 200809L
+#include "../../include/algorithms/stream.h"
+#include "../../include/algorithms/container.h"
+#include "../../include/algorithms/feistel.h"
+#include "../../include/file.h"
+#include "../../include/trace.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+/* =======================================================
+   Streaming stages (bounded memory, input size not needed)
+   - compress:   header with GSZ_RAW_FRAMED + one frame per block,
+                 holes of sparse inputs become hole frames; with
+                 opts.seekable the frame offsets are collected and
+                 written as an index after the end frame
+   - decompress: any container layout; frames and single-block LZW /
+                 RLE payloads are bounded (tile coders), other single-block
+                 and legacy files are buffered whole
+   - encrypt:    IV + CBC, padding applied on finish
+   - decrypt:    holds back the last block until finish to unpad
+   ======================================================= */
+
+typedef enum {
+    STAGE_COMPRESS,
+    STAGE_DECOMPRESS,
+    STAGE_ENCRYPT,
+    STAGE_DECRYPT
+} StageKind;
+
+typedef enum {
+    DEC_HEADER,   /* waiting for the container header */
+    DEC_WHOLE,    /* single-block container: buffer until finish */
+    DEC_TILES,    /* single-block LZW / RLE: decoded as it arrives */
+    DEC_FRAMES,   /* framed container */
+    DEC_END,      /* end frame seen, trailing bytes are ignored */
+    DEC_LEGACY    /* no header: buffer and decode by trial on finish */
+} DecodeState;
+
+struct StreamStage {
+    StageKind kind;
+    StreamStage *next;
+    StreamSink sink;
+    StreamHoleSink hole_sink;
+    void *sink_ctx;
+    uint64_t emitted;     /* bytes handed downstream */
+
+    unsigned char *buf;   /* pending input */
+    size_t len, cap;
+
+    /* compress */
+    CompressOptions opts;
+    size_t block_size;
+    int started;
+    uint64_t out_pos, raw_pos;   /* bytes emitted / consumed so far */
+    unsigned char *index;        /* GSZ_INDEX_ENTRY_LEN bytes per frame */
+    size_t index_len, index_cap;
+
+    /* decompress */
+    DecodeState state;
+    CompressionAlgorithm alg;
+    const CompressDict *dict;
+    size_t hdr_len;
+    StreamStage *inner;   /* GSZ_FLAG_NESTED: decodes the Huffman output */
+    GszTileCoder *tiles;
+    uint64_t raw_len;
+
+    /* encrypt / decrypt */
+    FeistelKey key;
+    uint8_t iv[8];
+    unsigned char *scratch;
+};
+
+static int stream_emit(StreamStage *st, const unsigned char *buf, size_t len) {
+    if (len == 0) return 0;
+    st->emitted += len;
+    if (st->next) return stream_push(st->next, buf, len);
+    if (st->sink) return st->sink(st->sink_ctx, buf, len);
+    return 1;
+}
+
+static const unsigned char stream_zeros[STREAM_CHUNK];
+
+/* len zero bytes as regular data */
+static int stream_push_zeros(StreamStage *st, uint64_t len) {
+    while (len > 0) {
+        size_t n = len < STREAM_CHUNK ? (size_t)len : STREAM_CHUNK;
+        if (stream_push(st, stream_zeros, n) != 0) return 1;
+        len -= n;
+    }
+    return 0;
+}
+
+static int stream_emit_hole(StreamStage *st, uint64_t len) {
+    if (len == 0) return 0;
+    if (st->next || st->hole_sink) st->emitted += len;
+    if (st->next) return stream_push_hole(st->next, len);
+    if (st->hole_sink) return st->hole_sink(st->sink_ctx, len);
+    while (len > 0) {
+        size_t n = len < STREAM_CHUNK ? (size_t)len : STREAM_CHUNK;
+        if (stream_emit(st, stream_zeros, n) != 0) return 1;
+        len -= n;
+    }
+    return 0;
+}
+
+static int stream_append(StreamStage *st, const unsigned char *buf, size_t len) {
+    if (st->len + len > st->cap) {
+        size_t nc = st->cap ? st->cap : STREAM_CHUNK;
+        while (nc < st->len + len) nc *= 2;
+        unsigned char *tmp = realloc(st->buf, nc);
+        if (!tmp) { perror("[stream] realloc"); return 1; }
+        st->buf = tmp;
+        st->cap = nc;
+    }
+    memcpy(st->buf + st->len, buf, len);
+    st->len += len;
+    return 0;
+}
+
+/* drops the first n pending bytes */
+static void stream_consume(StreamStage *st, size_t n) {
+    memmove(st->buf, st->buf + n, st->len - n);
+    st->len -= n;
+}
+
+static StreamStage *stream_new(StageKind kind) {
+    StreamStage *st = calloc(1, sizeof(StreamStage));
+    if (!st) { perror("[stream] calloc"); return NULL; }
+    st->kind = kind;
+    return st;
+}
+
+void stream_set_next(StreamStage *st, StreamStage *next) {
+    st->next = next;
+    st->sink = NULL;
+    st->hole_sink = NULL;
+}
+
+void stream_set_sink(StreamStage *st, StreamSink sink, void *ctx) {
+    st->next = NULL;
+    st->sink = sink;
+    st->sink_ctx = ctx;
+}
+
+void stream_set_hole_sink(StreamStage *st, StreamHoleSink hole) {
+    st->hole_sink = hole;
+}
+
+void stream_free(StreamStage *st) {
+    while (st) {
+        StreamStage *next = st->next;
+        stream_free(st->inner);
+        gsz_tile_free(st->tiles);
+        free(st->buf);
+        free(st->scratch);
+        free(st->index);
+        free(st);
+        st = next;
+    }
+}
+
+/* -------------------------------------------------------
+   Compress
+   ------------------------------------------------------- */
+
+StreamStage *stream_compress_new(const CompressOptions *opts, size_t block_size) {
+    StreamStage *st = stream_new(STAGE_COMPRESS);
+    if (!st) return NULL;
+    if (opts) {
+        st->opts = *opts;
+    } else {
+        st->opts.algorithm = ALG_LZW;
+    }
+    if (block_size == 0 || block_size > GSZ_FRAME_MAX_RAW) block_size = STREAM_BLOCK_SIZE;
+    st->block_size = block_size;
+    return st;
+}
+
+static int compress_emit(StreamStage *st, const unsigned char *buf, size_t len) {
+    st->out_pos += len;
+    return stream_emit(st, buf, len);
+}
+
+static int compress_start(StreamStage *st) {
+    if (st->started) return 0;
+    st->started = 1;
+    unsigned char hdr[GSZ_HEADER_MAX_LEN];
+    size_t hdr_len = gsz_write_header(hdr, st->opts.algorithm, GSZ_RAW_FRAMED, gsz_dict_for(&st->opts), st->opts.nested);
+    return compress_emit(st, hdr, hdr_len);
+}
+
+static void put_u32(unsigned char *p, uint32_t v) {
+    for (int i = 0; i < 4; ++i) p[i] = (unsigned char)(v >> (8 * i));
+}
+
+static void put_u64(unsigned char *p, uint64_t v) {
+    for (int i = 0; i < 8; ++i) p[i] = (unsigned char)(v >> (8 * i));
+}
+
+/* seekable: remember where the next frame starts, in both coordinates */
+static int compress_index_frame(StreamStage *st, uint64_t raw_len) {
+    if (st->opts.seekable) {
+        if (st->index_len + GSZ_INDEX_ENTRY_LEN > st->index_cap) {
+            size_t nc = st->index_cap ? st->index_cap * 2 : 64 * GSZ_INDEX_ENTRY_LEN;
+            unsigned char *tmp = realloc(st->index, nc);
+            if (!tmp) { perror("[stream] realloc index"); return 1; }
+            st->index = tmp;
+            st->index_cap = nc;
+        }
+        put_u64(st->index + st->index_len, st->raw_pos);
+        put_u64(st->index + st->index_len + 8, st->out_pos);
+        st->index_len += GSZ_INDEX_ENTRY_LEN;
+    }
+    st->raw_pos += raw_len;
+    return 0;
+}
+
+static uint32_t get_u32(const unsigned char *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static int compress_frame(StreamStage *st, const unsigned char *in, size_t len) {
+    unsigned char *out = NULL;
+    size_t out_len = 0;
+    if (gsz_encode_block(&st->opts, in, len, &out, &out_len) != 0) return 1;
+    unsigned char fh[GSZ_FRAME_HEADER_LEN];
+    put_u32(fh, (uint32_t)len);
+    put_u32(fh + 4, (uint32_t)out_len);
+    int rc = compress_index_frame(st, len);
+    if (rc == 0) rc = compress_emit(st, fh, sizeof(fh));
+    if (rc == 0) rc = compress_emit(st, out, out_len);
+    free(out);
+    return rc;
+}
+
+static int compress_push(StreamStage *st, const unsigned char *buf, size_t len) {
+    if (compress_start(st) != 0) return 1;
+    while (len > 0) {
+        if (st->len == 0 && len >= st->block_size) {
+            /* full block straight from the caller's buffer */
+            if (compress_frame(st, buf, st->block_size) != 0) return 1;
+            buf += st->block_size;
+            len -= st->block_size;
+            continue;
+        }
+        size_t take = st->block_size - st->len;
+        if (take > len) take = len;
+        if (stream_append(st, buf, take) != 0) return 1;
+        buf += take;
+        len -= take;
+        if (st->len == st->block_size) {
+            if (compress_frame(st, st->buf, st->len) != 0) return 1;
+            st->len = 0;
+        }
+    }
+    return 0;
+}
+
+static int compress_hole(StreamStage *st, uint64_t len) {
+    if (compress_start(st) != 0) return 1;
+    /* the pending partial block goes out first to keep the order */
+    if (st->len > 0) {
+        if (compress_frame(st, st->buf, st->len) != 0) return 1;
+        st->len = 0;
+    }
+    unsigned char fh[GSZ_HOLE_FRAME_LEN];
+    put_u32(fh, 0);
+    put_u32(fh + 4, GSZ_FRAME_HOLE);
+    put_u64(fh + 8, len);
+    if (compress_index_frame(st, len) != 0) return 1;
+    return compress_emit(st, fh, sizeof(fh));
+}
+
+static int compress_finish(StreamStage *st) {
+    if (compress_start(st) != 0) return 1;
+    if (st->len > 0) {
+        if (compress_frame(st, st->buf, st->len) != 0) return 1;
+        st->len = 0;
+    }
+    unsigned char end[GSZ_FRAME_HEADER_LEN] = {0};
+    if (compress_emit(st, end, sizeof(end)) != 0) return 1;
+    if (!st->opts.seekable) return 0;
+
+    unsigned char trailer[GSZ_INDEX_TRAILER_LEN];
+    put_u64(trailer, st->out_pos);
+    put_u64(trailer + 8, st->raw_pos);
+    put_u32(trailer + 16, (uint32_t)(st->index_len / GSZ_INDEX_ENTRY_LEN));
+    memcpy(trailer + 20, GSZ_INDEX_MAGIC, 4);
+    if (compress_emit(st, st->index, st->index_len) != 0) return 1;
+    return compress_emit(st, trailer, sizeof(trailer));
+}
+
+/* -------------------------------------------------------
+   Decompress
+   ------------------------------------------------------- */
+
+StreamStage *stream_decompress_new(const CompressOptions *opts) {
+    StreamStage *st = stream_new(STAGE_DECOMPRESS);
+    if (!st) return NULL;
+    if (opts) st->opts = *opts;
+    st->state = DEC_HEADER;
+    return st;
+}
+
+static int nested_sink(void *ctx, const unsigned char *buf, size_t len) {
+    return stream_emit((StreamStage *)ctx, buf, len);
+}
+
+static int nested_hole_sink(void *ctx, uint64_t len) {
+    return stream_emit_hole((StreamStage *)ctx, len);
+}
+
+/* Huffman wrapping another container (-m ch): only the header flag
+   says so, the payload is never sniffed */
+static int decompress_nest(StreamStage *st) {
+    st->inner = stream_decompress_new(&st->opts);
+    if (!st->inner) return 1;
+    stream_set_sink(st->inner, nested_sink, st);
+    stream_set_hole_sink(st->inner, nested_hole_sink);
+    return 0;
+}
+
+static int decompress_output(StreamStage *st, const unsigned char *buf, size_t len) {
+    if (st->inner) return stream_push(st->inner, buf, len);
+    return stream_emit(st, buf, len);
+}
+
+static int decompress_output_hole(StreamStage *st, uint64_t len) {
+    if (st->inner) return stream_push_zeros(st->inner, len);
+    return stream_emit_hole(st, len);
+}
+
+static int tile_sink(void *ctx, const unsigned char *buf, size_t len) {
+    return stream_emit((StreamStage *)ctx, buf, len);
+}
+
+static int decompress_tiles(StreamStage *st, const unsigned char *buf, size_t len) {
+    if (gsz_tile_push(st->tiles, buf, len, tile_sink, st) != 0) return 1;
+    if (gsz_tile_total(st->tiles) > st->raw_len) {
+        fprintf(stderr, "[stream] el contenido excede el tamaño de la cabecera\n");
+        return 1;
+    }
+    return 0;
+}
+
+static int decompress_header(StreamStage *st, int finishing) {
+    if (st->len < GSZ_HEADER_MAX_LEN && !finishing) return 0;
+    uint64_t raw_len;
+    uint32_t dict_id;
+    int nested;
+    st->hdr_len = gsz_read_header(st->buf, st->len, &st->alg, &raw_len, &dict_id, &nested);
+    if (st->hdr_len == 0) {
+        st->state = DEC_LEGACY;
+        return 0;
+    }
+    if (gsz_check_dict(dict_id, st->opts.dict, &st->dict) != 0) return 1;
+    if (nested && decompress_nest(st) != 0) return 1;
+    if (raw_len == GSZ_RAW_FRAMED) {
+        stream_consume(st, st->hdr_len);
+        st->state = DEC_FRAMES;
+    } else if (gsz_tile_supported(st->alg)) {
+        st->tiles = gsz_tile_decoder_new(st->alg, st->dict);
+        if (!st->tiles) return 1;
+        st->raw_len = raw_len;
+        stream_consume(st, st->hdr_len);
+        st->state = DEC_TILES;
+        /* what already came after the header */
+        size_t pending = st->len;
+        st->len = 0;
+        return decompress_tiles(st, st->buf, pending);
+    } else {
+        st->state = DEC_WHOLE;
+    }
+    return 0;
+}
+
+static int decompress_frames(StreamStage *st) {
+    size_t pos = 0;
+    int rc = 0;
+    while (st->len - pos >= GSZ_FRAME_HEADER_LEN) {
+        uint32_t raw = get_u32(st->buf + pos);
+        uint32_t comp = get_u32(st->buf + pos + 4);
+        if (raw == 0 && comp == 0) {
+            pos += GSZ_FRAME_HEADER_LEN;
+            st->state = DEC_END;
+            break;
+        }
+        if (raw == 0 && comp == GSZ_FRAME_HOLE) {
+            if (st->len - pos < GSZ_HOLE_FRAME_LEN) break;
+            uint64_t hole = 0;
+            for (int i = 0; i < 8; ++i) hole |= (uint64_t)st->buf[pos + 8 + i] << (8 * i);
+            if (decompress_output_hole(st, hole) != 0) return 1;
+            pos += GSZ_HOLE_FRAME_LEN;
+            continue;
+        }
+        if (raw > GSZ_FRAME_MAX_RAW || comp > 2 * (size_t)GSZ_FRAME_MAX_RAW + 1024) {
+            fprintf(stderr, "[stream] trama corrupta\n");
+            return 1;
+        }
+        if (st->len - pos - GSZ_FRAME_HEADER_LEN < comp) break;
+
+        unsigned char *out = NULL;
+        size_t out_len = 0;
+        rc = gsz_decode_block(st->alg, st->dict, st->buf + pos + GSZ_FRAME_HEADER_LEN, comp, raw, &out, &out_len);
+        if (rc == 0) rc = decompress_output(st, out, out_len);
+        free(out);
+        if (rc != 0) return 1;
+        pos += GSZ_FRAME_HEADER_LEN + comp;
+    }
+    stream_consume(st, pos);
+    return 0;
+}
+
+static int decompress_push(StreamStage *st, const unsigned char *buf, size_t len) {
+    if (st->state == DEC_END) return 0;
+    if (st->state == DEC_TILES) return decompress_tiles(st, buf, len);
+    if (stream_append(st, buf, len) != 0) return 1;
+    if (st->state == DEC_HEADER && decompress_header(st, 0) != 0) return 1;
+    if (st->state == DEC_FRAMES) return decompress_frames(st);
+    return 0;
+}
+
+static int decompress_finish(StreamStage *st) {
+    if (st->state == DEC_HEADER && decompress_header(st, 1) != 0) return 1;
+
+    unsigned char *out = NULL;
+    size_t out_len = 0;
+    int rc = 0;
+    if (st->state == DEC_FRAMES) {
+        if (decompress_frames(st) != 0) return 1;
+        if (st->state != DEC_END) {
+            fprintf(stderr, "[stream] entrada truncada (falta la trama final)\n");
+            return 1;
+        }
+    } else if (st->state == DEC_TILES) {
+        if (gsz_tile_finish(st->tiles, tile_sink, st) != 0) return 1;
+        if (gsz_tile_total(st->tiles) != st->raw_len) {
+            fprintf(stderr, "[stream] el contenido no coincide con el tamaño de la cabecera\n");
+            return 1;
+        }
+    } else if (st->state == DEC_WHOLE) {
+        uint64_t raw_len;
+        uint32_t dict_id;
+        gsz_read_header(st->buf, st->len, &st->alg, &raw_len, &dict_id, NULL);
+        if (raw_len > SIZE_MAX - 64) return 1;
+        rc = gsz_decode_block(st->alg, st->dict, st->buf + st->hdr_len, st->len - st->hdr_len, (size_t)raw_len, &out, &out_len);
+        if (rc == 0) rc = decompress_output(st, out, out_len);
+    } else if (st->state == DEC_LEGACY) {
+        rc = gsz_decode_legacy(st->buf, st->len, &st->opts, &out, &out_len);
+        if (rc == 0) rc = stream_emit(st, out, out_len);
+    }
+    free(out);
+    if (rc != 0) return 1;
+
+    if (st->inner && stream_finish(st->inner) != 0) return 1;
+    return 0;
+}
+
+/* -------------------------------------------------------
+   Encrypt / decrypt (Feistel CBC, header with KCV and IV first)
+   ------------------------------------------------------- */
+
+static StreamStage *cipher_new(StageKind kind, const FeistelKey *fk) {
+    if (!fk) return NULL;
+    StreamStage *st = stream_new(kind);
+    if (!st) return NULL;
+    st->scratch = malloc(STREAM_CHUNK);
+    if (!st->scratch) { free(st); return NULL; }
+    st->key = *fk;
+    return st;
+}
+
+StreamStage *stream_encrypt_new_key(const FeistelKey *fk) {
+    return cipher_new(STAGE_ENCRYPT, fk);
+}
+
+StreamStage *stream_decrypt_new_key(const FeistelKey *fk) {
+    return cipher_new(STAGE_DECRYPT, fk);
+}
+
+StreamStage *stream_encrypt_new(const char *key) {
+    if (!key) return NULL;
+    FeistelKey fk;
+    feistel_init(&fk, (const unsigned char *)key, strlen(key));
+    return cipher_new(STAGE_ENCRYPT, &fk);
+}
+
+StreamStage *stream_decrypt_new(const char *key) {
+    if (!key) return NULL;
+    FeistelKey fk;
+    feistel_init(&fk, (const unsigned char *)key, strlen(key));
+    return cipher_new(STAGE_DECRYPT, &fk);
+}
+
+static int encrypt_start(StreamStage *st) {
+    if (st->started) return 0;
+    st->started = 1;
+    if (feistel_random_iv(st->iv) != 0) return 1;
+    unsigned char hdr[FEISTEL_HEADER_LEN];
+    feistel_write_header(&st->key, st->iv, hdr);
+    return stream_emit(st, hdr, sizeof(hdr));
+}
+
+/* encrypts whole blocks from buf into scratch and emits them */
+static int encrypt_blocks(StreamStage *st, const unsigned char *buf, size_t len) {
+    while (len > 0) {
+        size_t n = len < STREAM_CHUNK ? len : STREAM_CHUNK;
+        trace_begin("feistel", NULL);
+        feistel_cbc_encrypt(&st->key, st->iv, buf, st->scratch, n);
+        trace_end();
+        if (stream_emit(st, st->scratch, n) != 0) return 1;
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int encrypt_push(StreamStage *st, const unsigned char *buf, size_t len) {
+    if (encrypt_start(st) != 0) return 1;
+    if (st->len > 0) {
+        /* complete the pending partial block first */
+        size_t take = 8 - st->len;
+        if (take > len) take = len;
+        if (stream_append(st, buf, take) != 0) return 1;
+        buf += take;
+        len -= take;
+        if (st->len < 8) return 0;
+        if (encrypt_blocks(st, st->buf, 8) != 0) return 1;
+        st->len = 0;
+    }
+    size_t whole = len & ~(size_t)7;
+    if (encrypt_blocks(st, buf, whole) != 0) return 1;
+    return stream_append(st, buf + whole, len - whole);
+}
+
+static int encrypt_finish(StreamStage *st) {
+    if (encrypt_start(st) != 0) return 1;
+    /* PKCS#7: always one final (partial or full) padding block */
+    unsigned char last[8];
+    size_t pad = 8 - st->len;
+    memcpy(last, st->buf, st->len);
+    memset(last + st->len, (int)pad, pad);
+    st->len = 0;
+    return encrypt_blocks(st, last, 8);
+}
+
+static int decrypt_blocks(StreamStage *st, const unsigned char *buf, size_t len) {
+    while (len > 0) {
+        size_t n = len < STREAM_CHUNK ? len : STREAM_CHUNK;
+        trace_begin("feistel", NULL);
+        feistel_cbc_decrypt(&st->key, st->iv, buf, st->scratch, n);
+        trace_end();
+        if (stream_emit(st, st->scratch, n) != 0) return 1;
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int decrypt_push(StreamStage *st, const unsigned char *buf, size_t len) {
+    if (stream_append(st, buf, len) != 0) return 1;
+    size_t pos = 0;
+    if (!st->started) {
+        /* the shortest legacy file (IV + one block) has a full header's length */
+        if (st->len < FEISTEL_HEADER_LEN) return 0;
+        if (feistel_read_header(&st->key, st->buf, st->len, st->iv, &pos) != 0) return 1;
+        st->started = 1;
+    }
+    /* keep the last complete block: it carries the padding */
+    size_t avail = st->len - pos;
+    size_t keep = avail % 8;
+    if (keep == 0 && avail > 0) keep = 8;
+    if (decrypt_blocks(st, st->buf + pos, avail - keep) != 0) return 1;
+    stream_consume(st, st->len - keep);
+    return 0;
+}
+
+static int decrypt_finish(StreamStage *st) {
+    if (!st->started || st->len != 8) {
+        fprintf(stderr, "[stream] texto cifrado truncado o mal formado\n");
+        return 1;
+    }
+    unsigned char last[8];
+    feistel_cbc_decrypt(&st->key, st->iv, st->buf, last, 8);
+    size_t pad;
+    if (feistel_unpad(last, &pad) != 0) {
+        fprintf(stderr, "[stream] padding invalido (clave incorrecta?)\n");
+        return 1;
+    }
+    st->len = 0;
+    return stream_emit(st, last, 8 - pad);
+}
+
+/* -------------------------------------------------------
+   Dispatch and fd helpers
+   ------------------------------------------------------- */
+
+int stream_push(StreamStage *st, const unsigned char *buf, size_t len) {
+    switch (st->kind) {
+        case STAGE_COMPRESS:   return compress_push(st, buf, len);
+        case STAGE_DECOMPRESS: return decompress_push(st, buf, len);
+        case STAGE_ENCRYPT:    return encrypt_push(st, buf, len);
+        case STAGE_DECRYPT:    return decrypt_push(st, buf, len);
+    }
+    return 1;
+}
+
+int stream_push_hole(StreamStage *st, uint64_t len) {
+    if (len == 0) return 0;
+    if (st->kind == STAGE_COMPRESS) return compress_hole(st, len);
+    return stream_push_zeros(st, len);
+}
+
+int stream_finish(StreamStage *st) {
+    int rc = 1;
+    switch (st->kind) {
+        case STAGE_COMPRESS:   rc = compress_finish(st); break;
+        case STAGE_DECOMPRESS: rc = decompress_finish(st); break;
+        case STAGE_ENCRYPT:    rc = encrypt_finish(st); break;
+        case STAGE_DECRYPT:    rc = decrypt_finish(st); break;
+    }
+    if (rc != 0) return 1;
+    return st->next ? stream_finish(st->next) : 0;
+}
+
+uint64_t stream_bytes_out(const StreamStage *st) {
+    return st->emitted;
+}
+
+int stream_fd_sink(void *ctx, const unsigned char *buf, size_t len) {
+    trace_begin("write", NULL);
+    int rc = safe_write(*(int *)ctx, buf, len) != 0;
+    trace_end();
+    return rc;
+}
+
+int stream_fd_hole_sink(void *ctx, uint64_t len) {
+    return fd_skip_hole(*(int *)ctx, len) != 0;
+}
+
+/* pushes len bytes read from fd */
+static int stream_push_fd(StreamStage *head, int fd, unsigned char *chunk, off_t len) {
+    while (len > 0) {
+        size_t n = len < STREAM_CHUNK ? (size_t)len : STREAM_CHUNK;
+        trace_begin("read", NULL);
+        ssize_t r = safe_read(fd, chunk, n);
+        trace_end();
+        if (r <= 0) return 1;
+        if (stream_push(head, chunk, (size_t)r) != 0) return 1;
+        len -= r;
+    }
+    return 0;
+}
+
+/* sparse input: only the data extents are read, holes are pushed as such */
+static int stream_run_sparse(StreamStage *head, int fd, unsigned char *chunk) {
+    struct stat st;
+    if (fstat(fd, &st) < 0) return 1;
+    off_t pos = 0, data, end;
+    int r;
+    while ((r = fd_next_extent(fd, pos, st.st_size, &data, &end)) == 0) {
+        if (stream_push_hole(head, (uint64_t)(data - pos)) != 0) return 1;
+        if (stream_push_fd(head, fd, chunk, end - data) != 0) return 1;
+        pos = end;
+    }
+    if (r < 0) return 1;
+    return stream_push_hole(head, (uint64_t)(st.st_size - pos));
+}
+
+int stream_run_fd(StreamStage *head, int in_fd) {
+    unsigned char *chunk = malloc(STREAM_CHUNK);
+    if (!chunk) { perror("[stream_run_fd] malloc"); return 1; }
+    int rc = 0;
+    if (fd_is_sparse(in_fd)) {
+        rc = stream_run_sparse(head, in_fd, chunk);
+        free(chunk);
+        return rc == 0 ? stream_finish(head) : 1;
+    }
+    for (;;) {
+        trace_begin("read", NULL);
+        ssize_t r = safe_read(in_fd, chunk, STREAM_CHUNK);
+        trace_end();
+        if (r < 0) { rc = 1; break; }
+        if (r == 0) break;
+        if (stream_push(head, chunk, (size_t)r) != 0) { rc = 1; break; }
+        if ((size_t)r < STREAM_CHUNK) break;   /* safe_read only stops short at EOF */
+    }
+    free(chunk);
+    if (rc == 0) rc = stream_finish(head);
+    return rc;
+}
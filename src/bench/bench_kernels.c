@@ -0,0 +1,106 @@
+#define _POSIX_C_SOURCE 200809L
+#include "../../include/algorithms/kernels.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* =======================================================
+   Kernel benchmark (make bench -> bin/gsea-bench)
+   - runs every kernel variant this CPU supports over the same
+     buffer, checks the result against the scalar variant and
+     prints MB/s and the speedup over scalar
+   - optional argument: buffer size in MiB (default 16)
+   ======================================================= */
+
+#define BENCH_REPS 5
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static const uint32_t bench_keys[16] = {
+    0x243F6A88u, 0x85A308D3u, 0x13198A2Eu, 0x03707344u, 0xA4093822u, 0x299F31D0u, 0x082EFA98u, 0xEC4E6C89u,
+    0x452821E6u, 0x38D01377u, 0xBE5466CFu, 0x34E90C6Cu, 0xC0AC29B7u, 0xC97C50DDu, 0x3F84D5B5u, 0xB5470917u
+};
+
+/* RLE-like scan: walk the whole buffer run by run, as the compressor does */
+static size_t scan_runs(const Kernels *k, const unsigned char *p, size_t n) {
+    size_t i = 0, runs = 0;
+    while (i < n) {
+        size_t left = n - i;
+        i += k->run_length(p + i, left < 255 ? left : 255);
+        runs++;
+    }
+    return runs;
+}
+
+int main(int argc, char **argv) {
+    size_t mib = argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : 16;
+    if (mib == 0) mib = 16;
+    size_t len = mib << 20;
+
+    unsigned char *runs = malloc(len), *a = malloc(len), *b = malloc(len);
+    unsigned char *out = malloc(len), *ref = malloc(len);
+    if (!runs || !a || !b || !out || !ref) { fprintf(stderr, "[bench] sin memoria\n"); return 1; }
+
+    /* runs of 1..300 bytes, random bytes for the rest */
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < len; ) {
+        seed = seed * 1103515245u + 12345u;
+        size_t r = 1 + (seed >> 16) % 300;
+        if (r > len - i) r = len - i;
+        memset(runs + i, (int)(seed >> 8) & 0xFF, r);
+        i += r;
+    }
+    for (size_t i = 0; i < len; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        a[i] = (unsigned char)(seed >> 16);
+        b[i] = (unsigned char)(seed >> 24);
+    }
+
+    int nvar = kernels_variant_count();
+    const char *names[] = { "run_length", "xor_bytes", "feistel_decrypt_blocks" };
+    double base[3] = { 0, 0, 0 };
+    size_t ref_runs = 0;
+    int rc = 0;
+
+    printf("buffer: %zu MiB, variante por defecto: %s\n", mib, kernels()->name);
+    printf("%-24s %-8s %10s %9s\n", "kernel", "isa", "MB/s", "speedup");
+    for (int kn = 0; kn < 3; ++kn) {
+        for (int v = 0; v < nvar; ++v) {
+            const Kernels *k = kernels_variant(v);
+            double best = 1e30;
+            size_t got_runs = 0;
+            for (int rep = 0; rep < BENCH_REPS; ++rep) {
+                double t0 = now_sec();
+                if (kn == 0) got_runs = scan_runs(k, runs, len);
+                else if (kn == 1) k->xor_bytes(out, a, b, len);
+                else k->feistel_decrypt_blocks(bench_keys, a, out, len / 8);
+                double t = now_sec() - t0;
+                if (t < best) best = t;
+            }
+
+            int ok = 1;
+            if (kn == 0) {
+                if (v == 0) ref_runs = got_runs;
+                ok = got_runs == ref_runs;
+            } else if (v == 0) {
+                memcpy(ref, out, len);
+            } else {
+                ok = memcmp(ref, out, len) == 0;
+            }
+            if (!ok) rc = 1;
+
+            double mbs = (double)len / best / 1e6;
+            if (v == 0) base[kn] = mbs;
+            printf("%-24s %-8s %10.1f %8.2fx%s\n", names[kn], k->name, mbs, mbs / base[kn], ok ? "" : "  DIFIERE");
+        }
+    }
+
+    free(runs); free(a); free(b); free(out); free(ref);
+    return rc;
+}
@@ -1,8 +1,11 @@
+#define _POSIX_C_SOURCE 200809L
 #include "../../include/directory.h"
 #include <sys/stat.h>
 #include <dirent.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
+#include <errno.h>
 
 bool is_directory(const char *path) {
     struct stat st;
@@ -23,4 +26,20 @@ void list_directory(const char *path) {
     }
 
     closedir(dir);
-}
\ No newline at end of file
+}
+
+int make_parent_dirs(const char *path) {
+    char *copy = strdup(path);
+    if (!copy) return 1;
+    int rc = 0;
+    for (char *c = strchr(copy + 1, '/'); c && rc == 0; c = strchr(c + 1, '/')) {
+        *c = '\0';
+        if (mkdir(copy, 0777) != 0 && errno != EEXIST) {
+            perror("[make_parent_dirs] mkdir");
+            rc = 1;
+        }
+        *c = '/';
+    }
+    free(copy);
+    return rc;
+}
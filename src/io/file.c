@@ -1,7 +1,97 @@
+#define _GNU_SOURCE
 #include "../../include/file.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/syscall.h>
 #include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+
+/* -------------------------------------------------------
+   Límite de E/S: un token bucket por recurso (bytes leídos,
+   bytes escritos, operaciones), compartido por todos los hilos.
+   Cada read()/write() toma sus tokens antes de hacerse; si el
+   balde queda en negativo, el hilo duerme lo que tarda en volver
+   a cero. Con límites activos, las llamadas se parten en trozos
+   de IO_THROTTLE_CHUNK para que el ritmo sea parejo.
+   ------------------------------------------------------- */
+
+#define IO_THROTTLE_CHUNK (1u << 20)
+#define IO_THROTTLE_BURST_SEC 0.1   // ráfaga permitida: 100 ms de tasa
+
+typedef struct {
+    pthread_mutex_t mu;
+    double rate;      // tokens por segundo (0 = sin límite)
+    double burst;
+    double tokens;
+    double last;
+} IoBucket;
+
+static IoBucket io_read_bucket = { PTHREAD_MUTEX_INITIALIZER, 0, 0, 0, 0 };
+static IoBucket io_write_bucket = { PTHREAD_MUTEX_INITIALIZER, 0, 0, 0, 0 };
+static IoBucket io_ops_bucket = { PTHREAD_MUTEX_INITIALIZER, 0, 0, 0, 0 };
+static bool io_throttled = false;
+
+static double io_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void io_bucket_init(IoBucket *b, double rate, double min_burst) {
+    b->rate = rate;
+    b->burst = rate * IO_THROTTLE_BURST_SEC;
+    if (b->burst < min_burst) b->burst = min_burst;
+    b->tokens = b->burst;
+    b->last = io_now();
+}
+
+static void io_bucket_take(IoBucket *b, double n) {
+    if (b->rate <= 0) return;
+    pthread_mutex_lock(&b->mu);
+    double now = io_now();
+    b->tokens += (now - b->last) * b->rate;
+    if (b->tokens > b->burst) b->tokens = b->burst;
+    b->last = now;
+    b->tokens -= n;
+    double wait = b->tokens < 0 ? -b->tokens / b->rate : 0;
+    pthread_mutex_unlock(&b->mu);
+    if (wait > 0) {
+        struct timespec ts = { (time_t)wait, (long)((wait - (double)(time_t)wait) * 1e9) };
+        while (nanosleep(&ts, &ts) != 0 && errno == EINTR) { }
+    }
+}
+
+int io_throttle_set(double read_mbps, double write_mbps, double iops) {
+    if (read_mbps < 0 || write_mbps < 0 || iops < 0) {
+        fprintf(stderr, "[io_throttle_set] los límites no pueden ser negativos\n");
+        return 1;
+    }
+    io_bucket_init(&io_read_bucket, read_mbps * 1e6, IO_THROTTLE_CHUNK);
+    io_bucket_init(&io_write_bucket, write_mbps * 1e6, IO_THROTTLE_CHUNK);
+    io_bucket_init(&io_ops_bucket, iops, 1);
+    io_throttled = read_mbps > 0 || write_mbps > 0 || iops > 0;
+    return 0;
+}
+
+int io_set_idle_priority(void) {
+#ifdef SYS_ioprio_set
+    // IOPRIO_WHO_PROCESS, hilo actual; clase IDLE (3) << IOPRIO_CLASS_SHIFT (13).
+    // Los hilos creados después la heredan.
+    if (syscall(SYS_ioprio_set, 1, 0, 3 << 13) != 0) {
+        perror("[io_set_idle_priority] ioprio_set");
+        return 1;
+    }
+    return 0;
+#else
+    fprintf(stderr, "[io_set_idle_priority] ioprio_set no disponible en este sistema\n");
+    return 1;
+#endif
+}
 
 int safe_open(const char *path, int flags, mode_t mode) {
     int fd = open(path, flags, mode);
@@ -15,7 +105,13 @@ ssize_t safe_read(int fd, void *buffer, size_t n) {
     size_t total = 0;
 
     while (total < n) {
-        ssize_t bytes = read(fd, (char*)buffer + total, n - total);
+        size_t want = n - total;
+        if (io_throttled) {
+            if (want > IO_THROTTLE_CHUNK) want = IO_THROTTLE_CHUNK;
+            io_bucket_take(&io_ops_bucket, 1);
+            io_bucket_take(&io_read_bucket, (double)want);
+        }
+        ssize_t bytes = read(fd, (char*)buffer + total, want);
 
         if (bytes < 0) {
             perror("[safe_read] Error al leer archivo");
@@ -31,11 +127,43 @@ ssize_t safe_read(int fd, void *buffer, size_t n) {
     return total;
 }
 
+ssize_t safe_pread(int fd, void *buffer, size_t n, uint64_t offset) {
+    size_t total = 0;
+
+    while (total < n) {
+        size_t want = n - total;
+        if (io_throttled) {
+            if (want > IO_THROTTLE_CHUNK) want = IO_THROTTLE_CHUNK;
+            io_bucket_take(&io_ops_bucket, 1);
+            io_bucket_take(&io_read_bucket, (double)want);
+        }
+        ssize_t bytes = pread(fd, (char*)buffer + total, want, (off_t)(offset + total));
+
+        if (bytes < 0) {
+            perror("[safe_pread] Error al leer archivo");
+            return -1;
+        }
+        if (bytes == 0) {
+            break; // EOF
+        }
+
+        total += bytes;
+    }
+
+    return total;
+}
+
 int safe_write(int fd, const void *buffer, size_t n) {
     size_t written = 0;
 
     while (written < n) {
-        ssize_t bytes = write(fd, (char*)buffer + written, n - written);
+        size_t want = n - written;
+        if (io_throttled) {
+            if (want > IO_THROTTLE_CHUNK) want = IO_THROTTLE_CHUNK;
+            io_bucket_take(&io_ops_bucket, 1);
+            io_bucket_take(&io_write_bucket, (double)want);
+        }
+        ssize_t bytes = write(fd, (char*)buffer + written, want);
 
         if (bytes < 0) {
             perror("[safe_write] Error al escribir archivo");
@@ -55,34 +183,331 @@ int safe_close(int fd) {
     return 0;
 }
 
-unsigned char *read_file_complete(const char *path, size_t *size_out) {
-    int fd = safe_open(path, O_RDONLY, 0);
-    if (fd < 0) return NULL;
-
+unsigned char *read_fd_headroom(int fd, size_t head, size_t tail, size_t *size_out) {
     struct stat st;
     if (fstat(fd, &st) < 0) {
-        perror("[read_file_complete] Error al obtener tamaño del archivo");
-        safe_close(fd);
+        perror("[read_file_headroom] Error al obtener tamaño del archivo");
         return NULL;
     }
 
     size_t size = st.st_size;
-    unsigned char *buffer = malloc(size);
+    size_t total = head + size + tail;
+    unsigned char *buffer = malloc(total > 0 ? total : 1);
     if (!buffer) {
-        perror("[read_file_complete] malloc");
-        safe_close(fd);
+        perror("[read_file_headroom] malloc");
         return NULL;
     }
 
-    ssize_t r = safe_read(fd, buffer, size);
+    ssize_t r = safe_read(fd, buffer + head, size);
     if (r < 0 || (size_t)r != size) {
-        fprintf(stderr, "[read_file_complete] Error al leer archivo completo\n");
+        fprintf(stderr, "[read_file_headroom] Error al leer archivo completo\n");
         free(buffer);
-        safe_close(fd);
         return NULL;
     }
 
-    safe_close(fd);
     *size_out = size;
     return buffer;
-}
\ No newline at end of file
+}
+
+unsigned char *read_file_headroom(const char *path, size_t head, size_t tail, size_t *size_out) {
+    int fd = safe_open(path, O_RDONLY, 0);
+    if (fd < 0) return NULL;
+    unsigned char *buffer = read_fd_headroom(fd, head, tail, size_out);
+    safe_close(fd);
+    return buffer;
+}
+
+unsigned char *read_file_complete(const char *path, size_t *size_out) {
+    return read_file_headroom(path, 0, 0, size_out);
+}
+
+bool fd_is_sparse(int fd) {
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size == 0) return false;
+    off_t hole = lseek(fd, 0, SEEK_HOLE);
+    lseek(fd, 0, SEEK_SET);
+    // sin soporte del sistema de archivos, el único "hueco" es el EOF
+    return hole >= 0 && hole < st.st_size;
+}
+
+int fd_next_extent(int fd, off_t pos, off_t size, off_t *data_start, off_t *data_end) {
+    off_t data = lseek(fd, pos, SEEK_DATA);
+    if (data < 0) {
+        if (errno == ENXIO) return 1; // solo queda hueco hasta el final
+        perror("[fd_next_extent] lseek SEEK_DATA");
+        return -1;
+    }
+    if (data >= size) return 1;
+    off_t hole = lseek(fd, data, SEEK_HOLE);
+    if (hole < 0 || hole > size) hole = size;
+    if (lseek(fd, data, SEEK_SET) < 0) {
+        perror("[fd_next_extent] lseek SEEK_SET");
+        return -1;
+    }
+    *data_start = data;
+    *data_end = hole;
+    return 0;
+}
+
+int fd_skip_hole(int fd, uint64_t len) {
+    if (lseek(fd, (off_t)len, SEEK_CUR) >= 0) return 0;
+    if (errno != ESPIPE) {
+        perror("[fd_skip_hole] lseek");
+        return -1;
+    }
+    // no se puede saltar (pipe / stdout): escribir los ceros
+    static const unsigned char zeros[4096];
+    while (len > 0) {
+        size_t n = len < sizeof(zeros) ? (size_t)len : sizeof(zeros);
+        if (safe_write(fd, zeros, n) != 0) return -1;
+        len -= n;
+    }
+    return 0;
+}
+
+int fd_finish_sparse(int fd) {
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) return 0;
+    off_t end = lseek(fd, 0, SEEK_CUR);
+    if (end < 0 || end <= st.st_size) return 0;
+    // el archivo termina en un hueco: lseek no cambia el tamaño, ftruncate sí
+    if (ftruncate(fd, end) < 0) {
+        perror("[fd_finish_sparse] ftruncate");
+        return -1;
+    }
+    return 0;
+}
+
+/* -------------------------------------------------------
+   Salidas atómicas y durabilidad (ver file.h)
+   ------------------------------------------------------- */
+
+#define OUTPUT_SYNC_MAX 16   // sistemas de archivos distintos recordados para syncfs
+
+static Durability output_durability = DURABILITY_NONE;
+static mode_t output_mode = 0644 & ~022;
+static bool output_use_tmpfile = true;
+static _Thread_local bool output_scratch;
+static atomic_uint output_seq;
+
+static pthread_mutex_t output_sync_mu = PTHREAD_MUTEX_INITIALIZER;
+static dev_t output_sync_dev[OUTPUT_SYNC_MAX];
+static int output_sync_fd[OUTPUT_SYNC_MAX];
+static int output_sync_count;
+static bool output_sync_all;   // más sistemas de archivos que OUTPUT_SYNC_MAX: sync()
+
+int io_parse_durability(const char *s, Durability *out) {
+    if (strcmp(s, "none") == 0) *out = DURABILITY_NONE;
+    else if (strcmp(s, "file") == 0) *out = DURABILITY_FILE;
+    else if (strcmp(s, "batch") == 0) *out = DURABILITY_BATCH;
+    else {
+        fprintf(stderr, "[io_parse_durability] valor invalido: %s (none, file o batch)\n", s);
+        return 1;
+    }
+    return 0;
+}
+
+void io_output_init(Durability durability) {
+    output_durability = durability;
+    mode_t mask = umask(0);
+    umask(mask);
+    output_mode = 0644 & ~mask;
+    // publicar un O_TMPFILE sin privilegios necesita /proc/self/fd
+    output_use_tmpfile = access("/proc/self/fd", X_OK) == 0;
+}
+
+void io_output_scratch(bool on) {
+    output_scratch = on;
+}
+
+// directorio de 'path' (malloc): "." si no tiene '/'
+static char *output_dir_of(const char *path) {
+    const char *slash = strrchr(path, '/');
+    if (!slash) return strdup(".");
+    if (slash == path) return strdup("/");
+    return strndup(path, (size_t)(slash - path));
+}
+
+// ".<nombre>.gsea-<sufijo>" junto a path (malloc)
+static char *output_hidden_name(const char *path, const char *suffix) {
+    const char *slash = strrchr(path, '/');
+    size_t dir_len = slash ? (size_t)(slash - path + 1) : 0;
+    const char *base = path + dir_len;
+    size_t len = dir_len + strlen(base) + strlen(suffix) + 8;
+    char *out = malloc(len);
+    if (out) snprintf(out, len, "%.*s.%s.gsea-%s", (int)dir_len, path, base, suffix);
+    return out;
+}
+
+int output_open(OutputFile *of, const char *path, uint64_t size_hint) {
+    of->fd = -1;
+    of->tmp_path = NULL;
+    of->direct = false;
+    of->path = strdup(path);
+    if (!of->path) return 1;
+
+    struct stat st;
+    if (output_scratch || (stat(path, &st) == 0 && !S_ISREG(st.st_mode))) {
+        of->direct = true;
+        of->fd = safe_open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    } else {
+#ifdef O_TMPFILE
+        if (output_use_tmpfile) {
+            char *dir = output_dir_of(path);
+            if (dir) of->fd = open(dir, O_TMPFILE | O_WRONLY, 0644);
+            free(dir);
+        }
+#endif
+        if (of->fd < 0) {
+            // sin O_TMPFILE (o el sistema de archivos no lo soporta): nombre oculto
+            of->tmp_path = output_hidden_name(path, "XXXXXX");
+            if (of->tmp_path) of->fd = mkstemp(of->tmp_path);
+            if (of->fd < 0) perror("[output_open] mkstemp");
+            else fchmod(of->fd, output_mode);
+        }
+        // reserva contigua; KEEP_SIZE para que el tamaño crezca con las escrituras
+        if (of->fd >= 0 && size_hint > 0) fallocate(of->fd, FALLOC_FL_KEEP_SIZE, 0, (off_t)size_hint);
+    }
+    if (of->fd < 0) {
+        free(of->tmp_path);
+        free(of->path);
+        return 1;
+    }
+    return 0;
+}
+
+static void output_remember_fs(const char *dir) {
+    struct stat st;
+    if (stat(dir, &st) != 0) return;
+    pthread_mutex_lock(&output_sync_mu);
+    bool known = output_sync_all;
+    for (int i = 0; i < output_sync_count && !known; ++i) known = output_sync_dev[i] == st.st_dev;
+    if (!known) {
+        if (output_sync_count == OUTPUT_SYNC_MAX) {
+            output_sync_all = true;
+        } else {
+            int fd = open(dir, O_RDONLY | O_DIRECTORY);
+            if (fd >= 0) {
+                output_sync_dev[output_sync_count] = st.st_dev;
+                output_sync_fd[output_sync_count++] = fd;
+            } else {
+                output_sync_all = true;
+            }
+        }
+    }
+    pthread_mutex_unlock(&output_sync_mu);
+}
+
+// O_TMPFILE: linkat del descriptor; si la ruta ya existe, linkat a un nombre
+// oculto y rename encima (rename sí reemplaza de forma atómica)
+static int output_link_tmpfile(OutputFile *of) {
+    char proc[64];
+    snprintf(proc, sizeof(proc), "/proc/self/fd/%d", of->fd);
+    if (linkat(AT_FDCWD, proc, AT_FDCWD, of->path, AT_SYMLINK_FOLLOW) == 0) return 0;
+    if (errno != EEXIST) return 1;
+    for (int attempt = 0; attempt < 16; ++attempt) {
+        char suffix[32];
+        snprintf(suffix, sizeof(suffix), "%ld-%u", (long)getpid(), atomic_fetch_add(&output_seq, 1));
+        char *tmp = output_hidden_name(of->path, suffix);
+        if (!tmp) return 1;
+        int rc = linkat(AT_FDCWD, proc, AT_FDCWD, tmp, AT_SYMLINK_FOLLOW);
+        if (rc == 0) {
+            rc = rename(tmp, of->path);
+            if (rc != 0) unlink(tmp);
+            free(tmp);
+            return rc != 0;
+        }
+        free(tmp);
+        if (errno != EEXIST) return 1;
+    }
+    return 1;
+}
+
+int output_commit(OutputFile *of) {
+    int rc = 0;
+    if (of->direct) {
+        rc = safe_close(of->fd) != 0;
+        free(of->path);
+        return rc;
+    }
+
+    if (output_durability == DURABILITY_FILE && fsync(of->fd) != 0) {
+        perror("[output_commit] fsync");
+        rc = 1;
+    }
+    if (rc == 0) {
+        rc = of->tmp_path ? rename(of->tmp_path, of->path) != 0 : output_link_tmpfile(of);
+        if (rc != 0) perror("[output_commit] no se pudo publicar la salida");
+    }
+    if (safe_close(of->fd) != 0) rc = 1;
+    if (rc != 0 && of->tmp_path) unlink(of->tmp_path);
+
+    if (rc == 0 && output_durability != DURABILITY_NONE) {
+        // el nombre nuevo vive en el directorio: también hay que sincronizarlo
+        char *dir = output_dir_of(of->path);
+        if (dir && output_durability == DURABILITY_FILE) {
+            int dfd = open(dir, O_RDONLY | O_DIRECTORY);
+            if (dfd < 0 || fsync(dfd) != 0) {
+                perror("[output_commit] fsync directorio");
+                rc = 1;
+            }
+            if (dfd >= 0) close(dfd);
+        } else if (dir) {
+            output_remember_fs(dir);
+        }
+        free(dir);
+    }
+    free(of->tmp_path);
+    free(of->path);
+    return rc;
+}
+
+void output_abort(OutputFile *of) {
+    close(of->fd);
+    if (of->tmp_path) unlink(of->tmp_path);   // O_TMPFILE desaparece solo al cerrar
+    free(of->tmp_path);
+    free(of->path);
+}
+
+int io_output_flush(void) {
+    int rc = 0;
+    pthread_mutex_lock(&output_sync_mu);
+    if (output_sync_all) sync();
+    for (int i = 0; i < output_sync_count; ++i) {
+        if (!output_sync_all && syncfs(output_sync_fd[i]) != 0) {
+            perror("[io_output_flush] syncfs");
+            rc = 1;
+        }
+        close(output_sync_fd[i]);
+    }
+    output_sync_count = 0;
+    output_sync_all = false;
+    pthread_mutex_unlock(&output_sync_mu);
+    return rc;
+}
+
+int unix_socket_listen(const char *path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "[unix_socket_listen] ruta de socket demasiado larga: %s\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("[unix_socket_listen] socket");
+        return -1;
+    }
+    unlink(path); // restos de una ejecución anterior
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 64) != 0) {
+        perror("[unix_socket_listen] bind/listen");
+        close(fd);
+        return -1;
+    }
+    // solo el usuario que lanzó gsea puede conectarse
+    chmod(path, 0600);
+    return fd;
+}
@@ -4,91 +4,335 @@
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <getopt.h>
 
 #include "../include/file.h"
 #include "../include/utils.h"
 #include "../include/directory.h"
 #include "../include/pipeline.h"
 #include "../include/executor.h"
+#include "../include/algorithms.h"
+#include "../include/metrics.h"
+#include "../include/trace.h"
+#include "../include/server.h"
+#include "../include/affinity.h"
 
 void print_usage(char *prog) {
-    printf("Uso: %s -i <input> -o <output> -m <ops> [-t max_threads] [-k key]\n", prog);
-    printf("  -i <input>    : archivo o directorio de entrada\n");
-    printf("  -o <output>   : archivo o directorio de salida\n");
-    printf("  -m <ops>      : secuencia de operaciones, ej: c (compress), e (encrypt), d (decompress), u (decrypt)\n");
-    printf("                  ejemplo: -m ce  (comprimir, luego encriptar)\n");
-    printf("  -t <N>        : max threads (solo si input es directorio). Default: nro CPUs\n");
+    printf("Uso: %s -i <input> -o <output> -m <ops> [-a alg] [-l nivel] [-w bits] [-t max_threads] [-k key]\n", prog);
+    printf("  -i <input>    : archivo o directorio de entrada (- = stdin, modo streaming)\n");
+    printf("  -o <output>   : archivo o directorio de salida (- = stdout, modo streaming)\n");
+    printf("  -m <ops>      : secuencia de operaciones, ej: c (compress), e (encrypt), d (decompress), u (decrypt),\n");
+    printf("                  h (etapa Huffman sobre la salida del compresor; d la deshace)\n");
+    printf("                  ejemplo: -m ce  (comprimir, luego encriptar); -m che (comprimir, Huffman, encriptar)\n");
+    printf("  -a <alg>      : algoritmo de compresion: lzw (default), rle, lzss, huffman\n");
+    printf("  -l <nivel>    : nivel LZSS 1..9 (1-4 greedy, 5-9 lazy). Default: %d\n", ALG_LZSS_DEFAULT_LEVEL);
+    printf("  -w <bits>     : ventana LZSS de 2^bits bytes (%d..%d). Default: %d\n", ALG_LZSS_MIN_WINDOW_BITS, ALG_LZSS_MAX_WINDOW_BITS, ALG_LZSS_MAX_WINDOW_BITS);
+    printf("  -t <N|auto>   : max threads (solo si input es directorio). Default: CPUs disponibles (afinidad y cuota del cgroup)\n");
+    printf("                  auto: ajusta la cantidad de hilos en marcha según el rendimiento medido\n");
     printf("  -k <key>      : clave para encriptacion (si aplica)\n");
+    printf("  -D <dict>     : diccionario entrenado para lzw / lzss (comprimir y descomprimir)\n");
+    printf("  --train <dict>: entrena un diccionario con una muestra de los archivos de -i (directorio)\n");
+    printf("  --dict-size <bytes> : tamaño del diccionario a entrenar (%d..%d). Default: %d\n", ALG_DICT_MIN_SIZE, ALG_DICT_MAX_SIZE, ALG_DICT_DEFAULT_SIZE);
+    printf("  --metrics-socket <ruta> : sirve métricas (formato Prometheus) en un socket Unix.\n");
+    printf("                  kill -USR1 <pid> imprime el progreso en stderr\n");
+    printf("  --trace <out.json> : línea de tiempo por hilo (Chrome / Perfetto trace-event)\n");
+    printf("  --serve <socket> : servicio: recibe trabajos por un socket Unix (ver README)\n");
+    printf("  --keys <archivo> : claves del servicio, una por línea: id:clave (-k queda como 'default')\n");
+    printf("  --max-read-mbps <MB/s>, --max-write-mbps <MB/s>, --max-iops <N> : límites de E/S (todos los hilos)\n");
+    printf("  --io-idle     : prioridad de E/S idle (solo usa el disco cuando está libre)\n");
+    printf("  --cpus <lista>: usa solo esas CPUs, ej: 0-7,16-23 (implica --pin)\n");
+    printf("  --pin         : fija cada hilo a una CPU mientras procesa un archivo (memoria en su nodo NUMA)\n");
+    printf("  --seekable    : comprime en tramas de 1 MiB con un índice al final (acceso aleatorio)\n");
+    printf("  --range <inicio:largo> : extrae solo ese rango del original (-m d, u o ud; largo vacío = hasta el final)\n");
+    printf("  --durability <none|file|batch> : fsync por archivo (file) o un syncfs al final (batch). Default: none\n");
+    printf("  --files-from <lista> : procesa las rutas de la lista (una por línea o separadas por NUL; - = stdin)\n");
+    printf("  --shard <i/N> : procesa solo el shard i de N (reparto estable y equilibrado por tamaño)\n");
+    printf("  --summary <archivo> : guarda un resumen del lote / shard\n");
+    printf("  --merge-summaries <resumen>... : combina resúmenes de varios shards (en stdout)\n");
 }
 
-int parse_sequence(const char *s, OperationType *out, size_t *out_len) {
-    size_t idx = 0;
-    for (size_t i = 0; s[i] != '\0' && idx < 4; i++) {
-        char ch = s[i];
-        switch (ch) {
-            case 'c': out[idx++] = OP_COMPRESS; break;
-            case 'd': out[idx++] = OP_DECOMPRESS; break;
-            case 'e': out[idx++] = OP_ENCRYPT; break;
-            case 'u': out[idx++] = OP_DECRYPT; break;
-            default:
-                fprintf(stderr, "Operacion desconocida: %c\n", ch);
-                return 1;
-        }
+// Límite de E/S: número > 0 (un valor mal escrito no debe quedar como "sin límite")
+static int parse_io_limit(const char *name, const char *s, double *out) {
+    char *end;
+    double v = strtod(s, &end);
+    if (end == s || *end != '\0' || !(v > 0) || v > 1e12) {
+        fprintf(stderr, "%s invalido: %s (numero mayor que 0)\n", name, s);
+        return 1;
     }
-    *out_len = idx;
+    *out = v;
     return 0;
 }
 
+// --range inicio:largo sobre un archivo: -m d (comprimido), u (encriptado) o ud
+static int run_range(const char *spec, const char *input, const char *output, const OperationType *seq, size_t seq_len, const char *key, const CompressOptions *comp) {
+    char *end;
+    unsigned long long start = strtoull(spec, &end, 10);
+    unsigned long long len = UINT64_MAX;
+    if (end == spec || *end != ':') {
+        fprintf(stderr, "--range invalido: %s (formato inicio:largo)\n", spec);
+        return 1;
+    }
+    if (end[1] != '\0') {
+        char *rest;
+        len = strtoull(end + 1, &rest, 10);
+        if (*rest != '\0') {
+            fprintf(stderr, "--range invalido: %s (formato inicio:largo)\n", spec);
+            return 1;
+        }
+    }
+    int decrypt = seq_len >= 1 && seq[0] == OP_DECRYPT;
+    int decompress = seq_len >= 1 && seq[seq_len - 1] == OP_DECOMPRESS;
+    if (seq_len == 0 || seq_len > 2 || (size_t)(decrypt + decompress) != seq_len) {
+        fprintf(stderr, "--range solo admite -m d, -m u o -m ud\n");
+        return 1;
+    }
+    if (decrypt && !key) {
+        fprintf(stderr, "--range con -m u necesita -k\n");
+        return 1;
+    }
+    if (strcmp(input, "-") == 0 || is_directory(input)) {
+        fprintf(stderr, "--range necesita un archivo en -i\n");
+        return 1;
+    }
+    FeistelKey fk;
+    if (decrypt) feistel_init(&fk, (const unsigned char *)key, strlen(key));
+
+    int out_stream = strcmp(output, "-") == 0;
+    OutputFile out = { STDOUT_FILENO, NULL, NULL, true };
+    if (!out_stream && output_open(&out, output, 0) != 0) return 1;
+    int rc = alg_extract_range(input, out.fd, decompress, decrypt ? &fk : NULL, comp, start, len);
+    if (!out_stream) {
+        if (rc == 0) rc = output_commit(&out);
+        else output_abort(&out);
+    }
+    return rc;
+}
+
 int main(int argc, char **argv) {
     char *input = NULL, *output = NULL, *ops = NULL, *key = NULL;
     int max_threads = 0;
 
+    // algoritmo por defecto: LZW, o el de GSEA_COMP si está definido (compatibilidad)
+    CompressOptions comp = { ALG_LZW, ALG_LZSS_DEFAULT_LEVEL, ALG_LZSS_MAX_WINDOW_BITS, NULL, 0, 0 };
+    const char *env = getenv("GSEA_COMP");
+    if (env && alg_parse_algorithm(env) != 0) comp.algorithm = alg_parse_algorithm(env);
+
+    char *dict_path = NULL, *train_path = NULL, *metrics_socket = NULL, *trace_path = NULL;
+    char *serve_path = NULL, *keys_path = NULL;
+    size_t dict_size = ALG_DICT_DEFAULT_SIZE;
+    double max_read_mbps = 0, max_write_mbps = 0, max_iops = 0;
+    int io_idle = 0, merge_summaries = 0;
+    char *files_from = NULL;
+    BatchOptions batch = { 0, 0, NULL };
+    Durability durability = DURABILITY_NONE;
+    char *range = NULL;
+    char *cpus = NULL;
+    int pin = 0;
+
+    enum { OPT_TRAIN = 256, OPT_DICT_SIZE, OPT_METRICS_SOCKET, OPT_TRACE, OPT_SERVE, OPT_KEYS,
+           OPT_MAX_READ, OPT_MAX_WRITE, OPT_MAX_IOPS, OPT_IO_IDLE,
+           OPT_FILES_FROM, OPT_SHARD, OPT_SUMMARY, OPT_MERGE_SUMMARIES,
+           OPT_DURABILITY, OPT_SEEKABLE, OPT_RANGE, OPT_CPUS, OPT_PIN };
+    static const struct option long_opts[] = {
+        { "dict",      required_argument, NULL, 'D' },
+        { "train",     required_argument, NULL, OPT_TRAIN },
+        { "dict-size", required_argument, NULL, OPT_DICT_SIZE },
+        { "metrics-socket", required_argument, NULL, OPT_METRICS_SOCKET },
+        { "trace",     required_argument, NULL, OPT_TRACE },
+        { "serve",     required_argument, NULL, OPT_SERVE },
+        { "keys",      required_argument, NULL, OPT_KEYS },
+        { "max-read-mbps",  required_argument, NULL, OPT_MAX_READ },
+        { "max-write-mbps", required_argument, NULL, OPT_MAX_WRITE },
+        { "max-iops",  required_argument, NULL, OPT_MAX_IOPS },
+        { "io-idle",   no_argument,       NULL, OPT_IO_IDLE },
+        { "files-from", required_argument, NULL, OPT_FILES_FROM },
+        { "shard",     required_argument, NULL, OPT_SHARD },
+        { "summary",   required_argument, NULL, OPT_SUMMARY },
+        { "merge-summaries", no_argument, NULL, OPT_MERGE_SUMMARIES },
+        { "durability", required_argument, NULL, OPT_DURABILITY },
+        { "seekable",  no_argument,       NULL, OPT_SEEKABLE },
+        { "range",     required_argument, NULL, OPT_RANGE },
+        { "cpus",      required_argument, NULL, OPT_CPUS },
+        { "pin",       no_argument,       NULL, OPT_PIN },
+        { NULL, 0, NULL, 0 }
+    };
+
     int opt;
-    while ((opt = getopt(argc, argv, "i:o:m:t:k:")) != -1) {
+    while ((opt = getopt_long(argc, argv, "i:o:m:t:k:a:l:w:D:", long_opts, NULL)) != -1) {
         switch (opt) {
+            case 'D': dict_path = optarg; break;
+            case OPT_TRAIN: train_path = optarg; break;
+            case OPT_DICT_SIZE: {
+                char *end;
+                unsigned long v = strtoul(optarg, &end, 10);
+                if (end == optarg || *end != '\0' || optarg[0] == '-' || v < ALG_DICT_MIN_SIZE || v > ALG_DICT_MAX_SIZE) {
+                    fprintf(stderr, "Tamaño de diccionario invalido: %s (%d..%d)\n", optarg, ALG_DICT_MIN_SIZE, ALG_DICT_MAX_SIZE);
+                    return 1;
+                }
+                dict_size = (size_t)v;
+                break;
+            }
+            case OPT_METRICS_SOCKET: metrics_socket = optarg; break;
+            case OPT_TRACE: trace_path = optarg; break;
+            case OPT_SERVE: serve_path = optarg; break;
+            case OPT_KEYS: keys_path = optarg; break;
+            case OPT_MAX_READ:
+                if (parse_io_limit("--max-read-mbps", optarg, &max_read_mbps) != 0) return 1;
+                break;
+            case OPT_MAX_WRITE:
+                if (parse_io_limit("--max-write-mbps", optarg, &max_write_mbps) != 0) return 1;
+                break;
+            case OPT_MAX_IOPS:
+                if (parse_io_limit("--max-iops", optarg, &max_iops) != 0) return 1;
+                break;
+            case OPT_IO_IDLE: io_idle = 1; break;
+            case OPT_FILES_FROM: files_from = optarg; break;
+            case OPT_SHARD:
+                if (batch_parse_shard(optarg, &batch) != 0) return 1;
+                break;
+            case OPT_SUMMARY: batch.summary_path = optarg; break;
+            case OPT_MERGE_SUMMARIES: merge_summaries = 1; break;
+            case OPT_DURABILITY:
+                if (io_parse_durability(optarg, &durability) != 0) return 1;
+                break;
+            case OPT_SEEKABLE: comp.seekable = 1; break;
+            case OPT_RANGE: range = optarg; break;
+            case OPT_CPUS: cpus = optarg; break;
+            case OPT_PIN: pin = 1; break;
+            case 'a':
+                comp.algorithm = alg_parse_algorithm(optarg);
+                if (comp.algorithm == 0) {
+                    fprintf(stderr, "Algoritmo desconocido: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'l':
+                comp.level = atoi(optarg);
+                if (comp.level < 1 || comp.level > 9) {
+                    fprintf(stderr, "Nivel invalido: %s (1..9)\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'w':
+                comp.window_bits = atoi(optarg);
+                if (comp.window_bits < ALG_LZSS_MIN_WINDOW_BITS || comp.window_bits > ALG_LZSS_MAX_WINDOW_BITS) {
+                    fprintf(stderr, "Ventana invalida: %s (%d..%d)\n", optarg, ALG_LZSS_MIN_WINDOW_BITS, ALG_LZSS_MAX_WINDOW_BITS);
+                    return 1;
+                }
+                break;
             case 'i': input = optarg; break;
             case 'o': output = optarg; break;
             case 'm': ops = optarg; break;
-            case 't': max_threads = atoi(optarg); break;
+            case 't':
+                max_threads = strcmp(optarg, "auto") == 0 ? EXECUTOR_THREADS_AUTO : atoi(optarg);
+                break;
             case 'k': key = optarg; break;
             default: print_usage(argv[0]); return 1;
         }
     }
 
-    if (!input || !output || !ops) {
+    if (merge_summaries) {
+        if (optind >= argc) {
+            fprintf(stderr, "--merge-summaries necesita al menos un resumen\n");
+            return 1;
+        }
+        return batch_merge_summaries(argc - optind, argv + optind);
+    }
+
+    // límites de E/S: antes de cualquier lectura y de crear hilos (la prioridad se hereda)
+    if (io_throttle_set(max_read_mbps, max_write_mbps, max_iops) != 0) return 1;
+    if (io_idle && io_set_idle_priority() != 0) return 1;
+    io_output_init(durability);
+    if (affinity_init(cpus, pin) != 0) return 1;
+
+    if (train_path) {
+        if (!input || !is_directory(input)) {
+            fprintf(stderr, "--train necesita un directorio de muestras en -i\n");
+            return 1;
+        }
+        return alg_train_dictionary(input, train_path, dict_size);
+    }
+
+    if (!serve_path && ((!input && !files_from) || !output || !ops)) {
         print_usage(argv[0]);
         return 1;
     }
 
+    // el diccionario se carga una vez y se comparte (solo lectura) entre hilos
+    CompressDict dict = { 0, NULL, 0 };
+    if (dict_path) {
+        if (alg_dict_load(dict_path, &dict) != 0) return 1;
+        comp.dict = &dict;
+    }
+
     OperationType seq[4] = {OP_NONE, OP_NONE, OP_NONE, OP_NONE};
     size_t seq_len = 0;
-    if (parse_sequence(ops, seq, &seq_len) != 0) return 1;
+    if (!serve_path && parse_sequence(ops, seq, &seq_len) != 0) { alg_dict_free(&dict); return 1; }
 
-    if (is_directory(input)) {
-        // output debe ser directorio
-        if (!is_directory(output)) {
-            // intentar crear salida
-            if (mkdir(output, 0777) != 0 && errno != EEXIST) {
-                perror("No se pudo crear directorio de salida");
-                return 1;
+    // métricas (SIGUSR1 / --metrics-socket): antes de crear cualquier hilo
+    if (metrics_start(metrics_socket) != 0) { alg_dict_free(&dict); return 1; }
+    if (trace_path && trace_start(trace_path) != 0) { metrics_stop(); alg_dict_free(&dict); return 1; }
+
+    int rc = 0;
+    int in_stream = input && strcmp(input, "-") == 0;
+    int out_stream = output && strcmp(output, "-") == 0;
+    if (range) {
+        rc = run_range(range, input, output, seq, seq_len, key, &comp);
+    } else if (serve_path) {
+        // servicio: los trabajos llegan por el socket (ops, rutas e id de clave)
+        rc = serve_unix_socket(serve_path, max_threads, key, keys_path, &comp);
+    } else if (files_from) {
+        // lista de archivos (--files-from): la salida es un directorio
+        rc = process_file_list(files_from, output, seq, seq_len, max_threads, key, &comp, &batch);
+    } else if (in_stream || out_stream) {
+        // streaming: "-" es stdin / stdout; el otro extremo puede ser un archivo
+        int in_fd = in_stream ? STDIN_FILENO : safe_open(input, O_RDONLY, 0);
+        OutputFile out = { STDOUT_FILENO, NULL, NULL, true };
+        rc = 1;
+        if (in_fd >= 0 && (out_stream || output_open(&out, output, 0) == 0)) {
+            rc = process_stream_pipeline(in_fd, out.fd, seq, seq_len, key, &comp);
+            if (!out_stream) {
+                if (rc == 0) rc = output_commit(&out);
+                else output_abort(&out);
             }
         }
-        return process_directory_concurrently(input, output, seq, seq_len, max_threads, key);
+        if (!in_stream && in_fd >= 0) safe_close(in_fd);
+    } else if (is_directory(input)) {
+        // output debe ser directorio
+        if (!is_directory(output) && mkdir(output, 0777) != 0 && errno != EEXIST) {
+            // no se pudo crear la salida
+            perror("No se pudo crear directorio de salida");
+            rc = 1;
+        } else {
+            rc = process_directory_concurrently(input, output, seq, seq_len, max_threads, key, &comp, &batch);
+        }
     } else {
         // archivo individual: ejecutar secuencial
-        ThreadArgs *args = malloc(sizeof(ThreadArgs));
-        if (!args) { perror("malloc"); return 1; }
-        args->input_file_path = strdup(input);
-        args->output_file_path = strdup(output);
-        args->key = key;
-        args->limiter = NULL;
-        for (size_t i = 0; i < 4; i++) args->sequence[i] = (i < seq_len) ? seq[i] : OP_NONE;
-
-        process_file_pipeline(args);
-        // process_file_pipeline libera args y rutas internamente
-        return 0;
+        ThreadArgs *args = calloc(1, sizeof(ThreadArgs));
+        if (!args) {
+            perror("calloc");
+            rc = 1;
+        } else {
+            int file_rc = 1;
+            args->input_file_path = strdup(input);
+            args->output_file_path = strdup(output);
+            args->key = key;
+            args->fkey = NULL;
+            args->comp = &comp;
+            args->limiter = NULL;
+            args->result = &file_rc;
+            for (size_t i = 0; i < 4; i++) args->sequence[i] = (i < seq_len) ? seq[i] : OP_NONE;
+
+            process_file_pipeline(args);
+            // process_file_pipeline libera args y rutas internamente
+            if (file_rc != 0) rc = 1;
+        }
     }
 
-    return 0;
+    // --durability batch: una sola sincronización por sistema de archivos
+    if (durability == DURABILITY_BATCH && io_output_flush() != 0) rc = 1;
+    metrics_stop();
+    if (trace_stop() != 0) rc = 1;
+    alg_dict_free(&dict);
+    return rc;
 }
-
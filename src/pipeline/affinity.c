@@ -0,0 +1,217 @@
+#define _GNU_SOURCE
+#include "../../include/affinity.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+
+/* =======================================================
+   CPU placement
+   - the usable CPUs are the process affinity mask, narrowed by
+     --cpus; the whole process is restricted to them up front
+   - with pinning, a worker claims the lowest free CPU of the list
+     for the duration of a file and gives it back afterwards;
+     since the worker allocates and first writes its own buffers,
+     the kernel places them on that CPU's NUMA node (first-touch)
+   - the default thread count is the number of usable CPUs capped
+     by the cgroup CPU quota, which is what a container really gets
+   ======================================================= */
+
+#define CGROUP_LINE_MAX 4096
+
+static cpu_set_t affinity_set;          /* usable CPUs */
+static int affinity_list[CPU_SETSIZE];  /* the same, as CPU numbers */
+static int affinity_count;
+static bool affinity_pin;
+static bool affinity_ready;
+
+static pthread_mutex_t affinity_mu = PTHREAD_MUTEX_INITIALIZER;
+static unsigned char affinity_busy[CPU_SETSIZE];
+
+/* "0-3,8,10-11" -> set; 0 on success */
+static int affinity_parse_list(const char *s, cpu_set_t *set) {
+    CPU_ZERO(set);
+    const char *p = s;
+    while (*p) {
+        char *end;
+        long lo = strtol(p, &end, 10), hi = lo;
+        if (end == p) return 1;
+        p = end;
+        if (*p == '-') {
+            hi = strtol(p + 1, &end, 10);
+            if (end == p + 1) return 1;
+            p = end;
+        }
+        if (lo < 0 || hi < lo || hi >= CPU_SETSIZE) return 1;
+        for (long c = lo; c <= hi; ++c) CPU_SET((int)c, set);
+        if (*p == ',') p++;
+        else if (*p) return 1;
+    }
+    return 0;
+}
+
+int affinity_init(const char *cpus, bool pin) {
+    if (sched_getaffinity(0, sizeof(affinity_set), &affinity_set) != 0) {
+        perror("[affinity_init] sched_getaffinity");
+        return 1;
+    }
+    if (cpus) {
+        cpu_set_t wanted;
+        if (affinity_parse_list(cpus, &wanted) != 0) {
+            fprintf(stderr, "[affinity_init] lista de CPUs invalida: %s (ej: 0-7,16-23)\n", cpus);
+            return 1;
+        }
+        CPU_AND(&affinity_set, &affinity_set, &wanted);
+        if (CPU_COUNT(&affinity_set) == 0) {
+            fprintf(stderr, "[affinity_init] ninguna CPU de '%s' está disponible para el proceso\n", cpus);
+            return 1;
+        }
+        // los hilos creados después heredan la máscara
+        if (sched_setaffinity(0, sizeof(affinity_set), &affinity_set) != 0) {
+            perror("[affinity_init] sched_setaffinity");
+            return 1;
+        }
+    }
+    affinity_count = 0;
+    for (int c = 0; c < CPU_SETSIZE; ++c) {
+        if (CPU_ISSET(c, &affinity_set)) affinity_list[affinity_count++] = c;
+    }
+    affinity_pin = pin || cpus != NULL;
+    affinity_ready = true;
+    return 0;
+}
+
+/* -------------------------------------------------------
+   cgroup CPU quota
+   ------------------------------------------------------- */
+
+/* v2: "max 100000" or "<quota> <period>"; < 0 when unlimited */
+static double cgroup_v2_limit(const char *dir) {
+    char path[CGROUP_LINE_MAX + 32];
+    snprintf(path, sizeof(path), "%s/cpu.max", dir);
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    char quota[32];
+    double period = 0;
+    int n = fscanf(f, "%31s %lf", quota, &period);
+    fclose(f);
+    if (n != 2 || strcmp(quota, "max") == 0 || period <= 0) return -1;
+    return atof(quota) / period;
+}
+
+/* v1: cpu.cfs_quota_us / cpu.cfs_period_us; < 0 when unlimited */
+static double cgroup_v1_limit(const char *dir) {
+    char path[CGROUP_LINE_MAX + 32];
+    double quota = -1, period = 0;
+    snprintf(path, sizeof(path), "%s/cpu.cfs_quota_us", dir);
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    if (fscanf(f, "%lf", &quota) != 1) quota = -1;
+    fclose(f);
+    snprintf(path, sizeof(path), "%s/cpu.cfs_period_us", dir);
+    f = fopen(path, "r");
+    if (!f) return -1;
+    if (fscanf(f, "%lf", &period) != 1) period = 0;
+    fclose(f);
+    return quota > 0 && period > 0 ? quota / period : -1;
+}
+
+static void limit_min(double *best, double v) {
+    if (v > 0 && (*best < 0 || v < *best)) *best = v;
+}
+
+/* smallest quota between our cgroup and its ancestors (v2), or the v1 cpu
+   controller; the mount may show only our own subtree (container), so the
+   mount root itself is checked too */
+static double cgroup_cpu_limit(void) {
+    double best = -1;
+    FILE *f = fopen("/proc/self/cgroup", "r");
+    if (!f) return best;
+    char line[CGROUP_LINE_MAX];
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\n")] = '\0';
+        char *path = strchr(line, ':');
+        if (!path) continue;
+        char *controllers = path + 1;
+        path = strchr(controllers, ':');
+        if (!path) continue;
+        *path++ = '\0';
+
+        char dir[CGROUP_LINE_MAX + 32];
+        if (controllers[0] == '\0') {
+            // v2: subir hasta la raíz, la cuota más chica manda
+            snprintf(dir, sizeof(dir), "/sys/fs/cgroup%s", strcmp(path, "/") == 0 ? "" : path);
+            for (;;) {
+                limit_min(&best, cgroup_v2_limit(dir));
+                char *slash = strrchr(dir, '/');
+                if (!slash || slash - dir <= (long)strlen("/sys/fs/cgroup")) break;
+                *slash = '\0';
+            }
+            limit_min(&best, cgroup_v2_limit("/sys/fs/cgroup"));
+        } else if (strstr(controllers, "cpu") && (strcmp(controllers, "cpu") == 0 || strstr(controllers, "cpu,") || strstr(controllers, ",cpu"))) {
+            static const char *mounts[] = { "/sys/fs/cgroup/cpu", "/sys/fs/cgroup/cpu,cpuacct" };
+            for (size_t m = 0; m < sizeof(mounts) / sizeof(mounts[0]); ++m) {
+                snprintf(dir, sizeof(dir), "%s%s", mounts[m], strcmp(path, "/") == 0 ? "" : path);
+                limit_min(&best, cgroup_v1_limit(dir));
+                limit_min(&best, cgroup_v1_limit(mounts[m]));
+            }
+        }
+    }
+    fclose(f);
+    return best;
+}
+
+int affinity_default_threads(void) {
+    int n = affinity_count;
+    if (!affinity_ready) {
+        cpu_set_t set;
+        n = sched_getaffinity(0, sizeof(set), &set) == 0 ? CPU_COUNT(&set) : 0;
+    }
+    if (n <= 0) n = 2;
+    double quota = cgroup_cpu_limit();
+    if (quota > 0) {
+        int cap = (int)quota + (quota > (int)quota);   // 1.5 CPUs -> 2 hilos
+        if (cap < n) n = cap;
+    }
+    return n > 0 ? n : 1;
+}
+
+/* -------------------------------------------------------
+   Pinning
+   ------------------------------------------------------- */
+
+int affinity_claim(void) {
+    if (!affinity_pin) return -1;
+    int slot = -1;
+    pthread_mutex_lock(&affinity_mu);
+    for (int i = 0; i < affinity_count; ++i) {
+        if (!affinity_busy[i]) {
+            affinity_busy[i] = 1;
+            slot = i;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&affinity_mu);
+    if (slot < 0) return -1;   // más hilos que CPUs: este queda libre en el conjunto
+
+    cpu_set_t one;
+    CPU_ZERO(&one);
+    CPU_SET(affinity_list[slot], &one);
+    if (sched_setaffinity(0, sizeof(one), &one) != 0) {
+        perror("[affinity_claim] sched_setaffinity");
+        affinity_release(slot);
+        return -1;
+    }
+    return slot;
+}
+
+void affinity_release(int slot) {
+    if (slot < 0) return;
+    // el hilo puede seguir vivo (servicio, hilo principal): vuelve al conjunto completo
+    sched_setaffinity(0, sizeof(affinity_set), &affinity_set);
+    pthread_mutex_lock(&affinity_mu);
+    affinity_busy[slot] = 0;
+    pthread_mutex_unlock(&affinity_mu);
+}
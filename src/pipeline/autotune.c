@@ -0,0 +1,226 @@
+#define _POSIX_C_SOURCE 200809L
+#include "../../include/autotune.h"
+#include "../../include/metrics.h"
+#include "../../include/affinity.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+
+/* =======================================================
+   Adaptive worker count (-t auto)
+   - the limit is the number of permits of the dispatcher's
+     semaphore: growing posts permits, shrinking leaves a debt that
+     the dispatcher pays by keeping the next permits it gets (the
+     tuner also takes idle ones with sem_trywait; never blocks)
+   - every window (>= 0.5 s and a few finished files) the tuner
+     compares bytes/s with the window before its last move: better
+     -> keep going with twice the step (slow start), worse
+     or within the 5% noise -> move back, halve the step, and wait
+     1, 2, 4 .. 16 windows before probing the other side (hill
+     climbing that settles on the peak instead of dithering)
+   - the first probe follows the waits: saturated CPUs with little
+     I/O wait shrink, anything else grows; a jump of more than 25%
+     without a move means a new workload and probing starts over
+   - growing is pointless when the dispatcher never waits for a
+     permit (the limit is not what holds the job back)
+   ======================================================= */
+
+#define AUTOTUNE_TICK_MS      100
+#define AUTOTUNE_WINDOW_USEC  500000u
+#define AUTOTUNE_MAX_WINDOW   5000000u   /* decide anyway after this long */
+#define AUTOTUNE_NOISE        0.05       /* smaller changes of bytes/s are noise */
+#define AUTOTUNE_SHIFT        0.25       /* larger ones, without a move, mean a new workload */
+#define AUTOTUNE_MAX_HOLD     16
+#define AUTOTUNE_CPU_BUSY     0.90       /* fraction of the CPUs in use */
+#define AUTOTUNE_IO_WAIT      0.50       /* fraction of worker time blocked */
+#define AUTOTUNE_DISPATCH_IDLE 0.10      /* dispatcher waited less: limit not binding */
+
+struct AutoTune {
+    sem_t *limiter;
+    int limit, min, max;
+    atomic_int debt;       /* permits still to take back */
+    int step, dir;
+    int moved;             /* size of the last move, 0 = the last window kept the limit */
+    int hold, backoff;     /* windows to wait before the next probe */
+    int first;
+    int ncpu;
+    double prev_rate;      /* bytes/s of the previous window, < 0 = none yet */
+    atomic_uint_fast64_t dispatch_wait;
+    atomic_int stop;
+    pthread_t thread;
+};
+
+static void autotune_sleep_ms(long ms) {
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+/* one permit of debt paid: 1 if there was debt */
+static int autotune_pay(AutoTune *at) {
+    int d = atomic_load(&at->debt);
+    while (d > 0) {
+        if (atomic_compare_exchange_weak(&at->debt, &d, d - 1)) return 1;
+    }
+    return 0;
+}
+
+/* takes back owed permits that nobody is using, without blocking */
+static void autotune_collect_debt(AutoTune *at) {
+    while (atomic_load(&at->debt) > 0 && sem_trywait(at->limiter) == 0) {
+        if (!autotune_pay(at)) sem_post(at->limiter);
+    }
+}
+
+/* moves the limit; 0 if it was already at a bound */
+static int autotune_set(AutoTune *at, int limit, double rate, double cpu_busy, double io_wait) {
+    if (limit < at->min) limit = at->min;
+    if (limit > at->max) limit = at->max;
+    if (limit == at->limit) return 0;
+    fprintf(stderr, "[autotune] hilos %d -> %d (%.1f MB/s, CPU %.0f%%, espera E/S %.0f%%)\n",
+            at->limit, limit, rate / 1e6, 100.0 * cpu_busy, 100.0 * io_wait);
+    for (int d = limit - at->limit; d > 0; --d) {
+        if (!autotune_pay(at)) sem_post(at->limiter);
+    }
+    if (at->limit > limit) atomic_fetch_add(&at->debt, at->limit - limit);
+    at->limit = limit;
+    autotune_collect_debt(at);
+    return 1;
+}
+
+/* the last probe did not pay off: back to where it started, the next
+   probe goes the other way, and probing gets rarer */
+static void autotune_revert(AutoTune *at, double rate, double cpu_busy, double io_wait) {
+    autotune_set(at, at->limit - at->dir * at->moved, rate, cpu_busy, io_wait);
+    at->moved = 0;
+    at->dir = -at->dir;
+    if (at->step > 1) at->step /= 2;
+    at->hold = at->backoff;
+    if (at->backoff < AUTOTUNE_MAX_HOLD) at->backoff *= 2;
+    at->prev_rate = -1;   /* re-measure the old setting */
+}
+
+static void autotune_decide(AutoTune *at, double rate, double cpu_busy, double io_wait, double dispatch_wait) {
+    if (at->moved) {
+        /* judge the last move against the window before it */
+        if (rate > at->prev_rate * (1.0 + AUTOTUNE_NOISE)) {
+            if (at->step < at->max / 4) at->step *= 2;
+            at->backoff = 1;
+        } else {
+            /* worse, or no better: more threads would only cost memory and seeks */
+            autotune_revert(at, rate, cpu_busy, io_wait);
+            return;
+        }
+    } else {
+        if (at->prev_rate >= 0 && (rate > at->prev_rate * (1.0 + AUTOTUNE_SHIFT) ||
+                                   rate < at->prev_rate * (1.0 - AUTOTUNE_SHIFT))) {
+            at->hold = 0;      /* the workload changed: explore again */
+            at->backoff = 1;
+        }
+        if (at->hold > 0) {
+            at->hold--;
+            at->prev_rate = rate;
+            return;
+        }
+        if (at->prev_rate < 0 && at->first) {
+            /* first window: the direction follows the bottleneck */
+            at->dir = cpu_busy >= AUTOTUNE_CPU_BUSY && io_wait < AUTOTUNE_IO_WAIT ? -1 : 1;
+            at->first = 0;
+        }
+    }
+    at->prev_rate = rate;
+    /* growing is pointless while the dispatcher never waits for a permit */
+    if (at->dir > 0 && dispatch_wait < AUTOTUNE_DISPATCH_IDLE) {
+        at->moved = 0;
+        return;
+    }
+    int from = at->limit;
+    if (autotune_set(at, at->limit + at->dir * at->step, rate, cpu_busy, io_wait)) {
+        at->moved = at->limit > from ? at->limit - from : from - at->limit;
+    } else {
+        /* at a bound: try the other side after a while */
+        at->moved = 0;
+        at->dir = -at->dir;
+        at->hold = at->backoff;
+        if (at->backoff < AUTOTUNE_MAX_HOLD) at->backoff *= 2;
+    }
+}
+
+static void *autotune_loop(void *arg) {
+    AutoTune *at = arg;
+    MetricsTotals last;
+    metrics_totals(&last);
+    uint64_t t_last = metrics_now_usec();
+    uint64_t wait_last = 0;
+
+    while (!atomic_load(&at->stop)) {
+        autotune_sleep_ms(AUTOTUNE_TICK_MS);
+        autotune_collect_debt(at);
+
+        MetricsTotals now;
+        metrics_totals(&now);
+        uint64_t t = metrics_now_usec();
+        uint64_t dt = t - t_last;
+        uint64_t files = now.files_done - last.files_done;
+        /* a window needs time and, unless it drags on, a few finished files */
+        if (dt < AUTOTUNE_WINDOW_USEC) continue;
+        if (files < (uint64_t)(at->limit < 4 ? at->limit : 4) && dt < AUTOTUNE_MAX_WINDOW) continue;
+        if (files == 0) {
+            last = now;
+            t_last = t;
+            continue;   /* huge files: nothing to compare yet */
+        }
+
+        double secs = (double)dt / 1e6;
+        double rate = (double)(now.bytes_in - last.bytes_in) / secs;
+        uint64_t wall = now.wall_usec - last.wall_usec, cpu = now.cpu_usec - last.cpu_usec;
+        double cpu_busy = (double)cpu / ((double)dt * at->ncpu);
+        double io_wait = wall > 0 && wall > cpu ? (double)(wall - cpu) / (double)wall : 0.0;
+        uint64_t waited = atomic_load(&at->dispatch_wait);
+        double dispatch_wait = (double)(waited - wait_last) / (double)dt;
+
+        autotune_decide(at, rate, cpu_busy, io_wait, dispatch_wait);
+        last = now;
+        t_last = t;
+        wait_last = waited;
+    }
+    return NULL;
+}
+
+AutoTune *autotune_start(sem_t *limiter, int initial, int max) {
+    AutoTune *at = calloc(1, sizeof(AutoTune));
+    if (!at) { perror("[autotune_start] calloc"); return NULL; }
+    at->limiter = limiter;
+    at->limit = initial;
+    at->min = 1;
+    at->max = max > initial ? max : initial;
+    at->ncpu = affinity_default_threads();
+    at->step = initial / 2 > 1 ? initial / 2 : 1;
+    at->dir = 1;
+    at->backoff = 1;
+    at->first = 1;
+    at->prev_rate = -1;
+    if (pthread_create(&at->thread, NULL, autotune_loop, at) != 0) {
+        perror("[autotune_start] pthread_create");
+        free(at);
+        return NULL;
+    }
+    return at;
+}
+
+void autotune_dispatch_wait(AutoTune *at, uint64_t usec) {
+    if (at) atomic_fetch_add(&at->dispatch_wait, usec);
+}
+
+int autotune_absorb(AutoTune *at) {
+    return at && autotune_pay(at);
+}
+
+void autotune_stop(AutoTune *at) {
+    if (!at) return;
+    atomic_store(&at->stop, 1);
+    pthread_join(at->thread, NULL);
+    free(at);
+}
@@ -0,0 +1,396 @@
+#define _POSIX_C_SOURCE 200809L
+#include "../../include/batch.h"
+#include "../../include/file.h"
+#include "../../include/utils.h"
+#include "../../include/directory.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+
+/* =======================================================
+   Batch lists
+   - a job is a list of (input path, path relative to the output
+     directory), from readdir or from --files-from
+   - --shard i/N: every node reads the same list and decides from
+     it alone, never from stat() (a node that sees another size, or
+     fails a stat, would shift every later file): when the list
+     gives every size ("size<TAB>path") files are sorted by size
+     (ties by path) and each goes to the least loaded shard (LPT,
+     ~1/N of the bytes each); otherwise a file goes to shard
+     FNV-1a(relative path) mod N (~1/N of the files each)
+   - summaries are "key value" lines whose counters add up, so
+     the per-node files can be merged (and merged again)
+   ======================================================= */
+
+#define BATCH_READ_CHUNK  65536
+#define BATCH_SUMMARY_TAG "gsea-summary 1"
+
+int batch_parse_shard(const char *s, BatchOptions *batch) {
+    unsigned i, n;
+    char extra;
+    if (sscanf(s, "%u/%u%c", &i, &n, &extra) != 2 || n == 0 || i >= n) {
+        fprintf(stderr, "[batch_parse_shard] shard invalido: %s (formato i/N, 0 <= i < N)\n", s);
+        return 1;
+    }
+    batch->shard_index = i;
+    batch->shard_count = n;
+    return 0;
+}
+
+static int batch_list_add(BatchList *list, const char *in, const char *rel, uint64_t size) {
+    if (list->count == list->cap) {
+        size_t cap = list->cap ? list->cap * 2 : 256;
+        BatchFile *tmp = realloc(list->files, cap * sizeof(*tmp));
+        if (!tmp) {
+            perror("[batch_list_add] realloc");
+            return 1;
+        }
+        list->files = tmp;
+        list->cap = cap;
+    }
+    BatchFile *f = &list->files[list->count];
+    f->in = strdup(in);
+    f->rel = strdup(rel);
+    f->size = size;
+    f->result = -1;
+    if (!f->in || !f->rel) {
+        free(f->in); free(f->rel);
+        perror("[batch_list_add] strdup");
+        return 1;
+    }
+    list->count++;
+    return 0;
+}
+
+void batch_list_free(BatchList *list) {
+    for (size_t i = 0; i < list->count; ++i) {
+        free(list->files[i].in);
+        free(list->files[i].rel);
+    }
+    free(list->files);
+    list->files = NULL;
+    list->count = list->cap = 0;
+}
+
+int batch_list_from_directory(BatchList *list, const char *dir_path) {
+    DIR *dir = opendir(dir_path);
+    if (!dir) {
+        perror("[batch_list_from_directory] opendir");
+        return 1;
+    }
+    int rc = 0;
+    struct dirent *entry;
+    while (rc == 0 && (entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+        char *full = build_path(dir_path, entry->d_name);
+        if (!full) { rc = 1; break; }
+        if (!is_directory(full)) rc = batch_list_add(list, full, entry->d_name, BATCH_SIZE_UNKNOWN);
+        free(full);
+    }
+    closedir(dir);
+    return rc;
+}
+
+/* optional "size<TAB>" in front of the path (find -printf '%s\t%p\n') */
+static const char *batch_size_prefix(const char *p, uint64_t *size) {
+    const char *c = p;
+    uint64_t v = 0;
+    while (*c >= '0' && *c <= '9' && v <= (UINT64_MAX - 9) / 10) v = v * 10 + (uint64_t)(*c++ - '0');
+    if (c == p || *c != '\t') {
+        *size = BATCH_SIZE_UNKNOWN;
+        return p;
+    }
+    *size = v;
+    return c + 1;
+}
+
+/* strip leading "/" and "./"; NULL if the path is empty or has ".." */
+static const char *batch_rel_path(const char *p) {
+    for (;;) {
+        if (p[0] == '/') p++;
+        else if (p[0] == '.' && p[1] == '/') p += 2;
+        else break;
+    }
+    if (*p == '\0' || strcmp(p, ".") == 0) return NULL;
+    for (const char *c = p; c; c = strchr(c, '/')) {
+        if (*c == '/') c++;
+        if (c[0] == '.' && c[1] == '.' && (c[2] == '/' || c[2] == '\0')) return NULL;
+    }
+    return p;
+}
+
+int batch_list_from_file(BatchList *list, const char *list_path) {
+    int from_stdin = strcmp(list_path, "-") == 0;
+    int fd = from_stdin ? STDIN_FILENO : safe_open(list_path, O_RDONLY, 0);
+    if (fd < 0) return 1;
+
+    size_t len = 0, cap = BATCH_READ_CHUNK;
+    char *buf = malloc(cap + 1);
+    int rc = buf ? 0 : 1;
+    while (rc == 0) {
+        if (len == cap) {
+            char *tmp = realloc(buf, cap * 2 + 1);
+            if (!tmp) { rc = 1; break; }
+            buf = tmp;
+            cap *= 2;
+        }
+        ssize_t r = safe_read(fd, buf + len, cap - len);
+        if (r < 0) { rc = 1; break; }
+        len += (size_t)r;
+        if (r == 0 || len < cap) break;   // safe_read only stops short at EOF
+    }
+    if (!from_stdin) safe_close(fd);
+    if (rc != 0) {
+        fprintf(stderr, "[batch_list_from_file] no se pudo leer %s\n", list_path);
+        free(buf);
+        return 1;
+    }
+
+    // find / xargs -0 style lists have NULs, everything else is one path per line
+    char sep = memchr(buf, '\0', len) ? '\0' : '\n';
+    buf[len] = sep;
+    size_t start = 0;
+    for (size_t i = 0; i <= len && rc == 0; ++i) {
+        if (buf[i] != sep) continue;
+        size_t end = i;
+        if (sep == '\n' && end > start && buf[end - 1] == '\r') end--;
+        buf[end] = '\0';
+        uint64_t size;
+        const char *path = batch_size_prefix(buf + start, &size);
+        start = i + 1;
+        if (*path == '\0') continue;
+        const char *rel = batch_rel_path(path);
+        if (!rel) {
+            fprintf(stderr, "[batch_list_from_file] ruta ignorada (vacia o con '..'): %s\n", path);
+            continue;
+        }
+        rc = batch_list_add(list, path, rel, size);
+    }
+    free(buf);
+    return rc;
+}
+
+/* -------------------------------------------------------
+   Sharding
+   ------------------------------------------------------- */
+
+static int batch_cmp_size_desc(const void *pa, const void *pb) {
+    const BatchFile *a = pa, *b = pb;
+    if (a->size != b->size) return a->size > b->size ? -1 : 1;
+    return strcmp(a->in, b->in);
+}
+
+/* min-heap of shards by (load, shard number) */
+static int batch_heap_less(const uint64_t *load, unsigned a, unsigned b) {
+    return load[a] < load[b] || (load[a] == load[b] && a < b);
+}
+
+static void batch_heap_down(unsigned *heap, unsigned n, const uint64_t *load, unsigned i) {
+    for (;;) {
+        unsigned l = 2 * i + 1, r = l + 1, m = i;
+        if (l < n && batch_heap_less(load, heap[l], heap[m])) m = l;
+        if (r < n && batch_heap_less(load, heap[r], heap[m])) m = r;
+        if (m == i) return;
+        unsigned t = heap[i]; heap[i] = heap[m]; heap[m] = t;
+        i = m;
+    }
+}
+
+static uint64_t batch_path_hash(const char *p) {
+    uint64_t h = 1469598103934665603ull;
+    for (; *p; ++p) {
+        h ^= (unsigned char)*p;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+/* keeps the files with keep[i] set, frees the rest */
+static void batch_keep(BatchList *list, const unsigned char *keep) {
+    size_t kept = 0;
+    for (size_t i = 0; i < list->count; ++i) {
+        if (keep[i]) {
+            list->files[kept++] = list->files[i];
+        } else {
+            free(list->files[i].in);
+            free(list->files[i].rel);
+        }
+    }
+    list->count = kept;
+}
+
+int batch_shard(BatchList *list, unsigned index, unsigned count) {
+    if (count <= 1) return 0;
+    unsigned char *keep = calloc(list->count ? list->count : 1, 1);
+    if (!keep) {
+        perror("[batch_shard] calloc");
+        return 1;
+    }
+    int sized = 1;
+    for (size_t i = 0; i < list->count && sized; ++i) sized = list->files[i].size != BATCH_SIZE_UNKNOWN;
+    if (!sized) {
+        // no sizes in the list: hash of the relative path, the same on every node
+        for (size_t i = 0; i < list->count; ++i) keep[i] = batch_path_hash(list->files[i].rel) % count == index;
+        batch_keep(list, keep);
+        free(keep);
+        return 0;
+    }
+    qsort(list->files, list->count, sizeof(BatchFile), batch_cmp_size_desc);
+
+    uint64_t *load = calloc(count, sizeof(*load));
+    unsigned *heap = malloc(count * sizeof(*heap));
+    if (!load || !heap) {
+        perror("[batch_shard] malloc");
+        free(load); free(heap); free(keep);
+        return 1;
+    }
+    for (unsigned s = 0; s < count; ++s) heap[s] = s;   // all loads 0: already a heap
+
+    for (size_t i = 0; i < list->count; ++i) {
+        unsigned s = heap[0];
+        // an empty file still costs an open and a create: count it as one byte
+        load[s] += list->files[i].size ? list->files[i].size : 1;
+        batch_heap_down(heap, count, load, 0);
+        keep[i] = s == index;
+    }
+    batch_keep(list, keep);
+    free(load);
+    free(heap);
+    free(keep);
+    return 0;
+}
+
+/* -------------------------------------------------------
+   Summaries
+   ------------------------------------------------------- */
+
+typedef struct {
+    uint64_t files, ok, failed, bytes_in, bytes_out, elapsed_usec;
+} BatchTotals;
+
+static void batch_print_totals(FILE *f, const BatchTotals *t) {
+    fprintf(f, "files %llu\nok %llu\nfailed %llu\nbytes_in %llu\nbytes_out %llu\nelapsed_usec %llu\n",
+            (unsigned long long)t->files, (unsigned long long)t->ok, (unsigned long long)t->failed,
+            (unsigned long long)t->bytes_in, (unsigned long long)t->bytes_out, (unsigned long long)t->elapsed_usec);
+}
+
+/* "fail <path>", with '\\' and newlines escaped so that any path fits one line */
+static void batch_print_fail(FILE *f, const char *path) {
+    fputs("fail ", f);
+    for (const char *c = path; *c; ++c) {
+        if (*c == '\n') fputs("\\n", f);
+        else if (*c == '\\') fputs("\\\\", f);
+        else fputc(*c, f);
+    }
+    fputc('\n', f);
+}
+
+int batch_write_summary(const BatchOptions *batch, const BatchList *list, const char *output_dir, uint64_t elapsed_usec) {
+    FILE *f = fopen(batch->summary_path, "w");
+    if (!f) {
+        perror("[batch_write_summary] fopen");
+        return 1;
+    }
+    BatchTotals t = { list->count, 0, 0, 0, 0, elapsed_usec };
+    for (size_t i = 0; i < list->count; ++i) {
+        const BatchFile *bf = &list->files[i];
+        struct stat st;
+        if (stat(bf->in, &st) == 0) t.bytes_in += (uint64_t)st.st_size;
+        if (bf->result != 0) { t.failed++; continue; }
+        t.ok++;
+        char *out = build_path(output_dir, bf->rel);
+        if (out && stat(out, &st) == 0) t.bytes_out += (uint64_t)st.st_size;
+        free(out);
+    }
+
+    fprintf(f, "%s\n", BATCH_SUMMARY_TAG);
+    fprintf(f, "shard %u/%u\n", batch->shard_count ? batch->shard_index : 0, batch->shard_count ? batch->shard_count : 1);
+    batch_print_totals(f, &t);
+    for (size_t i = 0; i < list->count; ++i) {
+        if (list->files[i].result != 0) batch_print_fail(f, list->files[i].in);
+    }
+    if (fclose(f) != 0) {
+        perror("[batch_write_summary] fclose");
+        return 1;
+    }
+    return 0;
+}
+
+int batch_merge_summaries(int count, char **paths) {
+    BatchTotals t = { 0, 0, 0, 0, 0, 0 };
+    unsigned shard_count = 0;
+    unsigned char *seen = NULL;
+    char **fails = NULL;
+    size_t nfails = 0;
+    int rc = 0;
+
+    for (int p = 0; p < count && rc == 0; ++p) {
+        FILE *f = fopen(paths[p], "r");
+        if (!f) {
+            fprintf(stderr, "[batch_merge_summaries] no se pudo abrir %s\n", paths[p]);
+            rc = 1;
+            break;
+        }
+        char *line = NULL;
+        size_t cap = 0;
+        ssize_t n;
+        int lineno = 0;
+        while (rc == 0 && (n = getline(&line, &cap, f)) >= 0) {
+            if (n > 0 && line[n - 1] == '\n') line[--n] = '\0';
+            unsigned long long v;
+            unsigned si, sn;
+            if (lineno++ == 0) {
+                if (strcmp(line, BATCH_SUMMARY_TAG) != 0) {
+                    fprintf(stderr, "[batch_merge_summaries] %s no es un resumen de gsea\n", paths[p]);
+                    rc = 1;
+                }
+            } else if (sscanf(line, "shard %u/%u", &si, &sn) == 2 && sn > 0 && si < sn) {
+                if (!seen) {
+                    shard_count = sn;
+                    seen = calloc(sn, 1);
+                    if (!seen) { rc = 1; break; }
+                }
+                if (sn != shard_count) {
+                    fprintf(stderr, "[batch_merge_summaries] %s: shard %u/%u, se esperaba N = %u\n", paths[p], si, sn, shard_count);
+                    rc = 1;
+                } else if (seen[si]) {
+                    fprintf(stderr, "[batch_merge_summaries] shard %u/%u repetido (%s)\n", si, sn, paths[p]);
+                    rc = 1;
+                }
+                if (rc == 0) seen[si] = 1;
+            } else if (strncmp(line, "fail ", 5) == 0) {
+                char **tmp = realloc(fails, (nfails + 1) * sizeof(*fails));
+                if (!tmp) { rc = 1; break; }
+                fails = tmp;
+                if (!(fails[nfails] = strdup(line))) { rc = 1; break; }
+                nfails++;
+            } else if (sscanf(line, "files %llu", &v) == 1) t.files += v;
+            else if (sscanf(line, "ok %llu", &v) == 1) t.ok += v;
+            else if (sscanf(line, "failed %llu", &v) == 1) t.failed += v;
+            else if (sscanf(line, "bytes_in %llu", &v) == 1) t.bytes_in += v;
+            else if (sscanf(line, "bytes_out %llu", &v) == 1) t.bytes_out += v;
+            else if (sscanf(line, "elapsed_usec %llu", &v) == 1) { if (v > t.elapsed_usec) t.elapsed_usec = v; }   // nodes run side by side
+        }
+        free(line);
+        fclose(f);
+    }
+
+    if (rc == 0) {
+        printf("%s\n", BATCH_SUMMARY_TAG);
+        unsigned missing = 0;
+        for (unsigned s = 0; s < shard_count; ++s) {
+            if (seen[s]) printf("shard %u/%u\n", s, shard_count);
+            else missing++;
+        }
+        batch_print_totals(stdout, &t);
+        for (size_t i = 0; i < nfails; ++i) printf("%s\n", fails[i]);
+        if (missing > 0) fprintf(stderr, "[batch_merge_summaries] faltan %u de %u shards\n", missing, shard_count);
+    }
+
+    for (size_t i = 0; i < nfails; ++i) free(fails[i]);
+    free(fails);
+    free(seen);
+    return rc;
+}
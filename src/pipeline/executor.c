@@ -1,30 +1,82 @@
 #define _POSIX_C_SOURCE 200809L
 #include "../../include/executor.h"
 #include "../../include/file.h"
+#include "../../include/affinity.h"
+#include "../../include/autotune.h"
 #include "../../include/utils.h"
 #include "../../include/directory.h"
 #include "../../include/algorithms.h"
+#include "../../include/algorithms/stream.h"
+#include "../../include/metrics.h"
+#include "../../include/trace.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
-#include <unistd.h>   // unlink, close, sysconf
+#include <unistd.h>   // unlink, close
 #include <errno.h>
-#include <dirent.h>
+
+int parse_sequence(const char *s, OperationType *out, size_t *out_len) {
+    size_t idx = 0;
+    for (size_t i = 0; s[i] != '\0' && idx < 4; i++) {
+        char ch = s[i];
+        switch (ch) {
+            case 'c': out[idx++] = OP_COMPRESS; break;
+            case 'd': out[idx++] = OP_DECOMPRESS; break;
+            case 'e': out[idx++] = OP_ENCRYPT; break;
+            case 'u': out[idx++] = OP_DECRYPT; break;
+            case 'h': out[idx++] = OP_HUFFMAN; break;
+            default:
+                fprintf(stderr, "Operacion desconocida: %c\n", ch);
+                return 1;
+        }
+    }
+    *out_len = idx;
+    return 0;
+}
+
+static uint64_t file_size_of(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 ? (uint64_t)st.st_size : 0;
+}
+
+/* op i de la secuencia (OP_NONE más allá de la última) */
+static OperationType op_at(const ThreadArgs *args, int i) {
+    return i < 4 ? args->sequence[i] : OP_NONE;
+}
+
+/* 'h' sobre la salida de 'c' o de otra 'h': envuelve un contenedor */
+static int op_wraps_container(const OperationType *seq, size_t i) {
+    return i > 0 && (seq[i - 1] == OP_COMPRESS || seq[i - 1] == OP_HUFFMAN);
+}
 
 void *process_file_pipeline(void *arg) {
     ThreadArgs *args = (ThreadArgs *)arg;
     char *current_input = args->input_file_path; // puntero que apunta al archivo de entrada actual
     char *next_output = NULL;
+    int ok = 0;
+
+    // con --pin el hilo queda en una CPU mientras dura el archivo: sus buffers
+    // se reservan y se tocan primero aquí, en la memoria de ese nodo NUMA
+    int cpu_slot = affinity_claim();
+    metrics_file_begin(args->input_file_path);
+    trace_begin("file", args->input_file_path);
 
     for (int i = 0; i < 4 && args->sequence[i] != OP_NONE; i++) {
         OperationType op = args->sequence[i];
+        // ce / ud seguidos se hacen en una sola pasada por tramas (sin temporal)
+        int fused = (op == OP_COMPRESS && op_at(args, i + 1) == OP_ENCRYPT) ||
+                    (op == OP_DECRYPT && op_at(args, i + 1) == OP_DECOMPRESS);
+        if (fused) i++;
+        int more = op_at(args, i + 1) != OP_NONE;
 
         /* 1) Determinar destino: si hay otra operación -> archivo temporal; si no -> salida final */
-        if (args->sequence[i+1] != OP_NONE) {
+        if (more) {
             char template[] = "/tmp/gsea_XXXXXX";
+            trace_begin("mkstemp", NULL);
             int fd = mkstemp(template);
+            trace_end();
             if (fd == -1) {
                 perror("[process_file_pipeline] mkstemp");
                 goto cleanup_and_exit;
@@ -39,22 +91,46 @@ void *process_file_pipeline(void *arg) {
             next_output = args->output_file_path; // apuntamos a la ruta final (no strdup)
         }
 
-        /* 2) Ejecutar la operación */
+        /* 2) Ejecutar la operación (a un temporal: sin publicación atómica ni fsync) */
+        io_output_scratch(more);
+        uint64_t t0 = metrics_now_usec();
+        uint64_t mid_len = 0;
         int rc = 1;
-        if (op == OP_COMPRESS) {
-            rc = alg_compress_copy(current_input, next_output);
+        if (fused) {
+            FeistelKey local;
+            const FeistelKey *fk = args->fkey;
+            if (!fk && args->key) {
+                feistel_init(&local, (const unsigned char *)args->key, strlen(args->key));
+                fk = &local;
+            }
+            rc = op == OP_COMPRESS ? alg_compress_encrypt_copy(current_input, next_output, args->comp, fk, &mid_len)
+                                   : alg_decrypt_decompress_copy(current_input, next_output, args->comp, fk, &mid_len);
+        } else if (op == OP_COMPRESS) {
+            rc = alg_compress_copy(current_input, next_output, args->comp);
         } else if (op == OP_DECOMPRESS) {
-            rc = alg_decompress_copy(current_input, next_output);
+            rc = alg_decompress_copy(current_input, next_output, args->comp);
         } else if (op == OP_ENCRYPT) {
-            rc = alg_encrypt_copy(current_input, next_output, args->key);
+            rc = args->fkey ? alg_encrypt_copy_key(current_input, next_output, args->fkey)
+                            : alg_encrypt_copy(current_input, next_output, args->key);
         } else if (op == OP_DECRYPT) {
-            rc = alg_decrypt_copy(current_input, next_output, args->key);
+            rc = args->fkey ? alg_decrypt_copy_key(current_input, next_output, args->fkey)
+                            : alg_decrypt_copy(current_input, next_output, args->key);
+        } else if (op == OP_HUFFMAN) {
+            // sobre la salida de c / h: el contenido es un contenedor y se marca
+            rc = alg_huffman_copy(current_input, next_output, op_wraps_container(args->sequence, i));
         }
 
         if (rc != 0) {
             fprintf(stderr, "[process_file_pipeline] Error aplicando op %d sobre %s -> %s\n", op, current_input, next_output);
             goto cleanup_and_exit;
         }
+        if (fused) {
+            // el tiempo de la pasada fusionada se cuenta en la primera op
+            metrics_op_done(op, file_size_of(current_input), mid_len, metrics_now_usec() - t0);
+            metrics_op_done(args->sequence[i], mid_len, file_size_of(next_output), 0);
+        } else {
+            metrics_op_done(op, file_size_of(current_input), file_size_of(next_output), metrics_now_usec() - t0);
+        }
 
         /* 3) Avanzar pipeline de forma segura:
            - guardamos el puntero anterior en 'prev_input'
@@ -66,19 +142,28 @@ void *process_file_pipeline(void *arg) {
         next_output = NULL;
 
         if (prev_input != args->input_file_path && prev_input != args->output_file_path) {
+            trace_begin("unlink", NULL);
             if (unlink(prev_input) != 0) {
                 perror("[process_file_pipeline] unlink temp");
             }
+            trace_end();
             free(prev_input);
         }
 
         /* Si era la última operación, informamos */
-        if (args->sequence[i+1] == OP_NONE) {
+        if (!more) {
             printf("[process_file_pipeline] Archivo procesado: %s -> %s\n", args->input_file_path, args->output_file_path);
         }
     }
+    ok = 1;
 
 cleanup_and_exit:
+    io_output_scratch(false);
+    affinity_release(cpu_slot);
+    metrics_file_end(ok);
+    trace_end();
+    trace_thread_done();
+
     /* Limpieza final: si current_input es un temporal distinto a input/output, liberarlo */
     if (current_input != NULL &&
         current_input != args->input_file_path &&
@@ -92,111 +177,238 @@ cleanup_and_exit:
     if (args->input_file_path) free(args->input_file_path);
     if (args->output_file_path) free(args->output_file_path);
 
+    if (args->result) *args->result = ok ? 0 : 1;
+
     /* Señalizar al semáforo (si aplica) y liberar args */
     if (args->limiter) sem_post(args->limiter);
     free(args);
     return NULL; // Terminar hilo
 }
 
-int process_directory_concurrently(const char *input_dir, const char *output_dir, OperationType *op_sequence, size_t seq_len, int max_threads, char *key) {
-    DIR *dir = opendir(input_dir);
-    if (!dir) {
-        perror("[process_directory_concurrently] opendir");
-        return 1;
-    }
+/* Hilos de run_batch: se crean desacoplados (detached) para que cada uno
+   libere su pila al terminar, sin esperar al final de una lista que puede
+   tener millones de archivos; run_batch solo cuenta los que siguen vivos. */
+typedef struct {
+    pthread_mutex_t mu;
+    pthread_cond_t cv;
+    size_t running;
+} BatchWait;
 
-    // crear directorio de salida si no existe
-    if (mkdir(output_dir, 0777) != 0 && errno != EEXIST) {
-        perror("[process_directory_concurrently] mkdir output");
-        closedir(dir);
-        return 1;
-    }
+typedef struct {
+    ThreadArgs args;     // primero: process_file_pipeline libera args = el job completo
+    BatchWait *wait;
+} BatchJob;
+
+static void *batch_worker(void *arg) {
+    BatchJob *job = arg;
+    BatchWait *wait = job->wait;
+    process_file_pipeline(&job->args);
+    pthread_mutex_lock(&wait->mu);
+    if (--wait->running == 0) pthread_cond_signal(&wait->cv);
+    pthread_mutex_unlock(&wait->mu);
+    return NULL;
+}
 
-    // determinar max threads
+/* Lanza un hilo por archivo de la lista (a lo sumo max_threads a la vez).
+   Cada archivo deja su resultado en list->files[i].result; devuelve 1 si
+   alguno falló o quedó sin procesar. */
+static int run_batch(BatchList *list, const char *output_dir, int nested, OperationType *op_sequence, size_t seq_len, int max_threads, char *key, const CompressOptions *comp) {
+    // determinar max threads (-t auto: arranca con las CPUs y se ajusta solo)
+    int auto_threads = max_threads == EXECUTOR_THREADS_AUTO;
     if (max_threads <= 0) {
-        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
-        max_threads = (ncpu > 0) ? (int)ncpu : 2;
+        max_threads = affinity_default_threads();
     }
 
+    // la clave se deriva una sola vez para todos los archivos
+    FeistelKey fkey;
+    if (key) feistel_init(&fkey, (const unsigned char *)key, strlen(key));
+
     sem_t limiter;
     if (sem_init(&limiter, 0, (unsigned)max_threads) != 0) {
-        perror("[process_directory_concurrently] sem_init");
-        closedir(dir);
+        perror("[run_batch] sem_init");
         return 1;
     }
 
-    struct dirent *entry;
-    pthread_t *threads = NULL;
-    size_t thread_count = 0;
-
-    while ((entry = readdir(dir)) != NULL) {
-        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+    pthread_attr_t attr;
+    if (pthread_attr_init(&attr) != 0 || pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED) != 0) {
+        perror("[run_batch] pthread_attr");
+        sem_destroy(&limiter);
+        return 1;
+    }
+    BatchWait wait = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, 0 };
 
-        char *full_input = build_path(input_dir, entry->d_name);
-        if (!full_input) continue;
+    metrics_files_total(list->count);
+    int tune_max = max_threads * EXECUTOR_AUTO_MAX_FACTOR;
+    if (tune_max < EXECUTOR_AUTO_MIN_MAX) tune_max = EXECUTOR_AUTO_MIN_MAX;
+    AutoTune *tune = auto_threads && list->count > (size_t)max_threads ? autotune_start(&limiter, max_threads, tune_max) : NULL;
 
-        if (is_directory(full_input)) {
-            free(full_input);
-            continue;
-        }
+    for (size_t f = 0; f < list->count; f++) {
+        BatchFile *bf = &list->files[f];
 
         // preparar args para el hilo
-        ThreadArgs *args = malloc(sizeof(ThreadArgs));
-        if (!args) {
-            perror("[process_directory_concurrently] malloc args");
-            free(full_input);
+        BatchJob *job = malloc(sizeof(BatchJob));
+        if (!job) {
+            perror("[run_batch] malloc args");
             continue;
         }
+        ThreadArgs *args = &job->args;
+        job->wait = &wait;
 
         // duplicar rutas para que cada hilo tenga su propia memoria
-        args->input_file_path = full_input;
-        args->output_file_path = build_path(output_dir, entry->d_name);
+        args->input_file_path = strdup(bf->in);
+        args->output_file_path = build_path(output_dir, bf->rel);
+        if (!args->input_file_path || !args->output_file_path ||
+            (nested && make_parent_dirs(args->output_file_path) != 0)) {
+            free(args->input_file_path);
+            free(args->output_file_path);
+            free(job);
+            continue;
+        }
         args->key = key;
+        args->fkey = key ? &fkey : NULL;
+        args->comp = comp;
         args->limiter = &limiter;
+        args->result = &bf->result;
         for (size_t i = 0; i < 4; i++) args->sequence[i] = (i < seq_len) ? op_sequence[i] : OP_NONE;
+        metrics_file_queued();
 
         // esperar disponibilidad (sem_wait), para no crear más de max_threads simultáneos
-        if (sem_wait(&limiter) != 0) {
-            perror("[process_directory_concurrently] sem_wait");
+        trace_begin("sem_wait", NULL);
+        uint64_t w0 = metrics_now_usec();
+        int wrc;
+        do {
+            wrc = sem_wait(&limiter);
+        } while (wrc == 0 && autotune_absorb(tune));   // permiso retenido: el límite bajó
+        autotune_dispatch_wait(tune, metrics_now_usec() - w0);
+        trace_end();
+        if (wrc != 0) {
+            perror("[run_batch] sem_wait");
             // cleanup and skip
             if (args->output_file_path) free(args->output_file_path);
             if (args->input_file_path) free(args->input_file_path);
-            free(args);
+            free(job);
             continue;
         }
 
         // crear hilo
-        threads = realloc(threads, (thread_count + 1) * sizeof(pthread_t));
-        if (!threads) {
-            perror("[process_directory_concurrently] realloc threads");
-            // liberar y seguir
-            if (args->output_file_path) free(args->output_file_path);
-            if (args->input_file_path) free(args->input_file_path);
-            free(args);
-            sem_post(&limiter);
-            continue;
-        }
-        if (pthread_create(&threads[thread_count], NULL, process_file_pipeline, args) != 0) {
-            perror("[process_directory_concurrently] pthread_create");
+        pthread_mutex_lock(&wait.mu);
+        wait.running++;
+        pthread_mutex_unlock(&wait.mu);
+        pthread_t thread;
+        if (pthread_create(&thread, &attr, batch_worker, job) != 0) {
+            perror("[run_batch] pthread_create");
+            pthread_mutex_lock(&wait.mu);
+            wait.running--;
+            pthread_mutex_unlock(&wait.mu);
             // cleanup
             if (args->output_file_path) free(args->output_file_path);
             if (args->input_file_path) free(args->input_file_path);
-            free(args);
+            free(job);
             sem_post(&limiter);
             continue;
         }
+    }
+
+    autotune_stop(tune);
+
+    // Esperar a los hilos que siguen vivos (cada uno descuenta al terminar)
+    trace_begin("join", NULL);
+    pthread_mutex_lock(&wait.mu);
+    while (wait.running > 0) pthread_cond_wait(&wait.cv, &wait.mu);
+    pthread_mutex_unlock(&wait.mu);
+    trace_end();
 
-        thread_count++;
+    pthread_attr_destroy(&attr);
+    pthread_cond_destroy(&wait.cv);
+    pthread_mutex_destroy(&wait.mu);
+    sem_destroy(&limiter);
+
+    int rc = 0;
+    for (size_t f = 0; f < list->count; f++) {
+        if (list->files[f].result != 0) rc = 1;
     }
+    return rc;
+}
 
-    closedir(dir);
+/* Reparte la lista (--shard), la procesa y escribe el resumen (--summary) */
+static int run_batch_list(BatchList *list, const char *output_dir, int nested, OperationType *op_sequence, size_t seq_len, int max_threads, char *key, const CompressOptions *comp, const BatchOptions *batch) {
+    uint64_t t0 = metrics_now_usec();
+    int rc = 0;
+    if (batch && batch->shard_count > 1) rc = batch_shard(list, batch->shard_index, batch->shard_count);
+    if (rc == 0) {
+        // el resumen se escribe también si fallaron archivos (los lista)
+        rc = run_batch(list, output_dir, nested, op_sequence, seq_len, max_threads, key, comp);
+        if (batch && batch->summary_path &&
+            batch_write_summary(batch, list, output_dir, metrics_now_usec() - t0) != 0) rc = 1;
+    }
+    batch_list_free(list);
+    return rc;
+}
 
-    // Esperar a todos los threads restantes. Cada hilo llama sem_post al terminar; aquí hacemos join.
-    for (size_t i = 0; i < thread_count; i++) {
-        pthread_join(threads[i], NULL);
+int process_directory_concurrently(const char *input_dir, const char *output_dir, OperationType *op_sequence, size_t seq_len, int max_threads, char *key, const CompressOptions *comp, const BatchOptions *batch) {
+    // crear directorio de salida si no existe
+    if (mkdir(output_dir, 0777) != 0 && errno != EEXIST) {
+        perror("[process_directory_concurrently] mkdir output");
+        return 1;
     }
 
-    if (threads) free(threads);
-    sem_destroy(&limiter);
-    return 0;
+    BatchList list = { NULL, 0, 0 };
+    if (batch_list_from_directory(&list, input_dir) != 0) {
+        batch_list_free(&list);
+        return 1;
+    }
+    return run_batch_list(&list, output_dir, 0, op_sequence, seq_len, max_threads, key, comp, batch);
+}
+
+int process_file_list(const char *list_path, const char *output_dir, OperationType *op_sequence, size_t seq_len, int max_threads, char *key, const CompressOptions *comp, const BatchOptions *batch) {
+    if (mkdir(output_dir, 0777) != 0 && errno != EEXIST) {
+        perror("[process_file_list] mkdir output");
+        return 1;
+    }
+
+    BatchList list = { NULL, 0, 0 };
+    if (batch_list_from_file(&list, list_path) != 0) {
+        batch_list_free(&list);
+        return 1;
+    }
+    return run_batch_list(&list, output_dir, 1, op_sequence, seq_len, max_threads, key, comp, batch);
+}
+
+int process_stream_pipeline(int in_fd, int out_fd, OperationType *op_sequence, size_t seq_len, char *key, const CompressOptions *comp) {
+    StreamStage *head = NULL, *tail = NULL;
+
+    for (size_t i = 0; i < seq_len; i++) {
+        StreamStage *st = NULL;
+        OperationType op = op_sequence[i];
+        if (op == OP_COMPRESS) {
+            st = stream_compress_new(comp, STREAM_BLOCK_SIZE);
+        } else if (op == OP_DECOMPRESS) {
+            st = stream_decompress_new(comp);
+        } else if (op == OP_ENCRYPT) {
+            st = stream_encrypt_new(key);
+        } else if (op == OP_DECRYPT) {
+            st = stream_decrypt_new(key);
+        } else if (op == OP_HUFFMAN) {
+            CompressOptions huff = { ALG_HUFFMAN, 0, 0, NULL, 0, op_wraps_container(op_sequence, i) };
+            st = stream_compress_new(&huff, STREAM_BLOCK_SIZE);
+        }
+        if (!st) {
+            fprintf(stderr, "[process_stream_pipeline] No se pudo preparar la op %d%s\n", op,
+                    (op == OP_ENCRYPT || op == OP_DECRYPT) && !key ? " (falta -k)" : "");
+            stream_free(head);
+            return 1;
+        }
+        if (tail) stream_set_next(tail, st);
+        else head = st;
+        tail = st;
+    }
+    if (!head) return 1;
+
+    stream_set_sink(tail, stream_fd_sink, &out_fd);
+    stream_set_hole_sink(tail, stream_fd_hole_sink);
+    int rc = stream_run_fd(head, in_fd);
+    stream_free(head);
+    if (rc == 0 && fd_finish_sparse(out_fd) != 0) rc = 1;
+    if (rc != 0) fprintf(stderr, "[process_stream_pipeline] Error procesando el flujo\n");
+    return rc;
 }
\ No newline at end of file
@@ -0,0 +1,468 @@
+#define _POSIX_C_SOURCE 200809L
+#include "../../include/metrics.h"
+#include "../../include/file.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+/* =======================================================
+   Metrics
+   - every thread claims one slot (cache-line aligned) for each file
+     and only touches its own counters; readers add all slots up
+   - slots come in chunks of 64: when all are taken (-t auto, big
+     -t) a new chunk is published, so every running file keeps its
+     "in progress" entry; only past METRICS_MAX_CHUNKS do threads
+     share slot 0, so all counters are atomics (relaxed: there is no
+     ordering to keep)
+   - a dedicated thread sigwait()s SIGUSR1 and prints a summary,
+     another one serves the Prometheus text on a Unix socket
+   ======================================================= */
+
+#define METRICS_SLOTS      64   /* per chunk */
+#define METRICS_MAX_CHUNKS 256  /* 16384 threads at once */
+#define METRICS_OPS        (OP_HUFFMAN + 1)
+#define METRICS_BUCKETS    20   /* bucket k: <= 2^(k + 6) us (64 us .. ~33 s), then +Inf */
+#define METRICS_PATH_MAX   256
+#define METRICS_POLL_MS    250
+
+typedef struct {
+    atomic_uint_fast64_t count;
+    atomic_uint_fast64_t bytes_in;
+    atomic_uint_fast64_t bytes_out;
+    atomic_uint_fast64_t usec_sum;
+    atomic_uint_fast64_t bucket[METRICS_BUCKETS + 1];
+} OpCounters;
+
+typedef struct {
+    _Alignas(64) atomic_int owned;
+    atomic_int threads;                  /* threads currently using the slot */
+    atomic_uint_fast64_t files_started;
+    atomic_uint_fast64_t files_done;
+    atomic_uint_fast64_t files_failed;
+    atomic_uint_fast64_t wall_usec;      /* time spent on files ... */
+    atomic_uint_fast64_t cpu_usec;       /* ... and the part of it on a CPU */
+    OpCounters ops[METRICS_OPS];
+
+    /* file in progress, only for owned slots (list of "stuck" files) */
+    pthread_mutex_t cur_lock;
+    char cur_path[METRICS_PATH_MAX];
+    uint64_t cur_start;
+} MetricsSlot;
+
+static MetricsSlot metrics_slots[METRICS_SLOTS];   /* first chunk */
+static MetricsSlot *metrics_chunks[METRICS_MAX_CHUNKS] = { metrics_slots };
+static atomic_int metrics_nchunks = 1;             /* chunks published (release / acquire) */
+static pthread_mutex_t metrics_grow_lock = PTHREAD_MUTEX_INITIALIZER;
+static _Thread_local MetricsSlot *metrics_self;
+static _Thread_local uint64_t metrics_file_wall0, metrics_file_cpu0;
+
+static atomic_uint_fast64_t metrics_total;
+static atomic_uint_fast64_t metrics_queued;
+static uint64_t metrics_t0;
+
+static int metrics_running;
+static atomic_int metrics_stopping;
+static pthread_t metrics_sig_thread, metrics_sock_thread;
+static int metrics_sock_fd = -1;
+static char *metrics_sock_path;
+
+static const char *metrics_op_names[METRICS_OPS] = {
+    "none", "compress", "decompress", "encrypt", "decrypt", "huffman"
+};
+
+#define RELAXED memory_order_relaxed
+
+uint64_t metrics_now_usec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+static uint64_t metrics_thread_cpu_usec(void) {
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) return 0;
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+/* -------------------------------------------------------
+   Update side (called by the worker threads)
+   ------------------------------------------------------- */
+
+/* slot k of the published chunks (k < metrics_slot_count()) */
+static int metrics_slot_count(void) {
+    return atomic_load_explicit(&metrics_nchunks, memory_order_acquire) * METRICS_SLOTS;
+}
+
+static MetricsSlot *metrics_slot_at(int k) {
+    return &metrics_chunks[k / METRICS_SLOTS][k % METRICS_SLOTS];
+}
+
+/* a new chunk whose first slot is already ours; NULL at the limit */
+static MetricsSlot *metrics_grow(int seen) {
+    MetricsSlot *mine = NULL;
+    pthread_mutex_lock(&metrics_grow_lock);
+    int n = atomic_load_explicit(&metrics_nchunks, memory_order_relaxed);
+    if (n == seen && n < METRICS_MAX_CHUNKS) {
+        MetricsSlot *chunk = aligned_alloc(_Alignof(MetricsSlot), sizeof(MetricsSlot) * METRICS_SLOTS);
+        if (chunk) {
+            memset(chunk, 0, sizeof(MetricsSlot) * METRICS_SLOTS);
+            for (int i = 0; i < METRICS_SLOTS; ++i) pthread_mutex_init(&chunk[i].cur_lock, NULL);
+            atomic_store(&chunk[0].owned, 1);
+            metrics_chunks[n] = chunk;
+            atomic_store_explicit(&metrics_nchunks, n + 1, memory_order_release);
+            mine = &chunk[0];
+        }
+    }
+    pthread_mutex_unlock(&metrics_grow_lock);
+    return mine;
+}
+
+static MetricsSlot *metrics_slot(void) {
+    if (metrics_self) return metrics_self;
+    for (;;) {
+        int n = metrics_slot_count();
+        for (int k = 1; k < n; ++k) {
+            int expected = 0;
+            MetricsSlot *s = metrics_slot_at(k);
+            if (atomic_compare_exchange_strong(&s->owned, &expected, 1)) {
+                metrics_self = s;
+                return metrics_self;
+            }
+        }
+        if (n / METRICS_SLOTS >= METRICS_MAX_CHUNKS) break;
+        MetricsSlot *s = metrics_grow(n / METRICS_SLOTS);
+        if (s) {
+            metrics_self = s;
+            return metrics_self;
+        }
+        /* another thread grew first (scan again) or out of memory */
+        if (metrics_slot_count() == n) break;
+    }
+    metrics_self = &metrics_slots[0];
+    return metrics_self;
+}
+
+void metrics_files_total(uint64_t n) {
+    atomic_store_explicit(&metrics_total, n, RELAXED);
+}
+
+void metrics_file_queued(void) {
+    atomic_fetch_add_explicit(&metrics_queued, 1, RELAXED);
+}
+
+void metrics_file_begin(const char *path) {
+    MetricsSlot *s = metrics_slot();
+    atomic_fetch_add_explicit(&s->threads, 1, RELAXED);
+    atomic_fetch_add_explicit(&s->files_started, 1, RELAXED);
+    metrics_file_wall0 = metrics_now_usec();
+    metrics_file_cpu0 = metrics_thread_cpu_usec();
+    if (s == &metrics_slots[0]) return;
+    pthread_mutex_lock(&s->cur_lock);
+    snprintf(s->cur_path, sizeof(s->cur_path), "%s", path);
+    s->cur_start = metrics_now_usec();
+    pthread_mutex_unlock(&s->cur_lock);
+}
+
+void metrics_file_end(int ok) {
+    MetricsSlot *s = metrics_slot();
+    atomic_fetch_add_explicit(ok ? &s->files_done : &s->files_failed, 1, RELAXED);
+    /* wall minus CPU = time blocked (disk, network, throttle, locks) */
+    atomic_fetch_add_explicit(&s->wall_usec, metrics_now_usec() - metrics_file_wall0, RELAXED);
+    atomic_fetch_add_explicit(&s->cpu_usec, metrics_thread_cpu_usec() - metrics_file_cpu0, RELAXED);
+    atomic_fetch_sub_explicit(&s->threads, 1, RELAXED);
+    /* the file is done: hand the slot (and its totals) over; a thread
+       that keeps running (--serve worker, main thread) claims one again
+       for its next file, and one on the shared slot 0 gets to retry */
+    metrics_self = NULL;
+    if (s == &metrics_slots[0]) return;
+    pthread_mutex_lock(&s->cur_lock);
+    s->cur_path[0] = '\0';
+    pthread_mutex_unlock(&s->cur_lock);
+    atomic_store(&s->owned, 0);
+}
+
+void metrics_op_done(OperationType op, uint64_t bytes_in, uint64_t bytes_out, uint64_t usec) {
+    if ((int)op <= OP_NONE || (int)op >= METRICS_OPS) return;
+    OpCounters *c = &metrics_slot()->ops[op];
+    int b = 0;
+    while (b < METRICS_BUCKETS && usec > ((uint64_t)1 << (b + 6))) b++;
+    atomic_fetch_add_explicit(&c->count, 1, RELAXED);
+    atomic_fetch_add_explicit(&c->bytes_in, bytes_in, RELAXED);
+    atomic_fetch_add_explicit(&c->bytes_out, bytes_out, RELAXED);
+    atomic_fetch_add_explicit(&c->usec_sum, usec, RELAXED);
+    atomic_fetch_add_explicit(&c->bucket[b], 1, RELAXED);
+}
+
+/* -------------------------------------------------------
+   Read side: add every slot up
+   ------------------------------------------------------- */
+
+typedef struct {
+    uint64_t count, bytes_in, bytes_out, usec_sum;
+    uint64_t bucket[METRICS_BUCKETS + 1];
+} OpTotals;
+
+typedef struct {
+    uint64_t total, queued, started, done, failed;
+    uint64_t wall_usec, cpu_usec;
+    int64_t threads;
+    OpTotals ops[METRICS_OPS];
+    uint64_t bytes_in, bytes_out;   /* all operations */
+} MetricsSnapshot;
+
+static void metrics_collect(MetricsSnapshot *m) {
+    memset(m, 0, sizeof(*m));
+    m->total = atomic_load_explicit(&metrics_total, RELAXED);
+    m->queued = atomic_load_explicit(&metrics_queued, RELAXED);
+    int n = metrics_slot_count();
+    for (int i = 0; i < n; ++i) {
+        MetricsSlot *s = metrics_slot_at(i);
+        m->threads += atomic_load_explicit(&s->threads, RELAXED);
+        m->started += atomic_load_explicit(&s->files_started, RELAXED);
+        m->done += atomic_load_explicit(&s->files_done, RELAXED);
+        m->failed += atomic_load_explicit(&s->files_failed, RELAXED);
+        m->wall_usec += atomic_load_explicit(&s->wall_usec, RELAXED);
+        m->cpu_usec += atomic_load_explicit(&s->cpu_usec, RELAXED);
+        for (int op = OP_NONE + 1; op < METRICS_OPS; ++op) {
+            OpCounters *c = &s->ops[op];
+            OpTotals *t = &m->ops[op];
+            t->count += atomic_load_explicit(&c->count, RELAXED);
+            t->bytes_in += atomic_load_explicit(&c->bytes_in, RELAXED);
+            t->bytes_out += atomic_load_explicit(&c->bytes_out, RELAXED);
+            t->usec_sum += atomic_load_explicit(&c->usec_sum, RELAXED);
+            for (int b = 0; b <= METRICS_BUCKETS; ++b) t->bucket[b] += atomic_load_explicit(&c->bucket[b], RELAXED);
+        }
+    }
+    for (int op = OP_NONE + 1; op < METRICS_OPS; ++op) {
+        m->bytes_in += m->ops[op].bytes_in;
+        m->bytes_out += m->ops[op].bytes_out;
+    }
+    if (m->threads < 0) m->threads = 0;   /* counters are read one by one */
+}
+
+void metrics_totals(MetricsTotals *t) {
+    MetricsSnapshot m;
+    metrics_collect(&m);
+    t->files_done = m.done + m.failed;
+    t->bytes_in = m.bytes_in;
+    t->wall_usec = m.wall_usec;
+    t->cpu_usec = m.cpu_usec;
+}
+
+static uint64_t metrics_in_flight(const MetricsSnapshot *m) {
+    uint64_t finished = m->done + m->failed;
+    return m->started > finished ? m->started - finished : 0;
+}
+
+static uint64_t metrics_waiting(const MetricsSnapshot *m) {
+    return m->queued > m->started ? m->queued - m->started : 0;
+}
+
+/* SIGUSR1: human readable summary on stderr */
+static void metrics_dump(FILE *f, uint64_t *last_usec, uint64_t *last_bytes) {
+    MetricsSnapshot m;
+    metrics_collect(&m);
+    uint64_t now = metrics_now_usec();
+    double elapsed = (double)(now - metrics_t0) / 1e6;
+    double window = (double)(now - *last_usec) / 1e6;
+    double mb_in = (double)m.bytes_in / 1e6;
+
+    /* the total is only known when walking a directory */
+    char total[32] = "";
+    if (m.total > 0) snprintf(total, sizeof(total), "/%llu", (unsigned long long)m.total);
+    fprintf(f, "[metrics] %.1f s | archivos: %llu%s hechos, %llu con error, %llu en curso, %llu en cola | hilos activos: %lld\n",
+            elapsed, (unsigned long long)m.done, total, (unsigned long long)m.failed,
+            (unsigned long long)metrics_in_flight(&m), (unsigned long long)metrics_waiting(&m), (long long)m.threads);
+    fprintf(f, "[metrics] procesado: %.1f MB -> %.1f MB | %.2f MB/s promedio, %.2f MB/s desde el ultimo reporte\n",
+            mb_in, (double)m.bytes_out / 1e6, elapsed > 0 ? mb_in / elapsed : 0.0,
+            window > 0 ? (double)(m.bytes_in - *last_bytes) / 1e6 / window : 0.0);
+    if (m.wall_usec > 0) {
+        fprintf(f, "[metrics] hilos: %.0f%% del tiempo en CPU, %.0f%% esperando (E/S)\n",
+                100.0 * (double)m.cpu_usec / (double)m.wall_usec,
+                100.0 * (1.0 - (double)m.cpu_usec / (double)m.wall_usec));
+    }
+    for (int op = OP_NONE + 1; op < METRICS_OPS; ++op) {
+        const OpTotals *t = &m.ops[op];
+        if (t->count == 0) continue;
+        fprintf(f, "[metrics]   %-10s %llu ops, %.1f MB -> %.1f MB, %.2f ms de media\n", metrics_op_names[op],
+                (unsigned long long)t->count, (double)t->bytes_in / 1e6, (double)t->bytes_out / 1e6,
+                (double)t->usec_sum / 1e3 / (double)t->count);
+    }
+    int nslots = metrics_slot_count();
+    for (int i = 1; i < nslots; ++i) {
+        MetricsSlot *s = metrics_slot_at(i);
+        pthread_mutex_lock(&s->cur_lock);
+        if (s->cur_path[0] != '\0') {
+            fprintf(f, "[metrics]   en curso: %s (%.1f s)\n", s->cur_path, (double)(now - s->cur_start) / 1e6);
+        }
+        pthread_mutex_unlock(&s->cur_lock);
+    }
+    fflush(f);
+    *last_usec = now;
+    *last_bytes = m.bytes_in;
+}
+
+/* Prometheus text exposition format */
+static void metrics_prometheus(FILE *f) {
+    MetricsSnapshot m;
+    metrics_collect(&m);
+
+    fprintf(f, "# HELP gsea_uptime_seconds Segundos desde el inicio\n# TYPE gsea_uptime_seconds gauge\n");
+    fprintf(f, "gsea_uptime_seconds %.3f\n", (double)(metrics_now_usec() - metrics_t0) / 1e6);
+    fprintf(f, "# HELP gsea_files Archivos por estado\n# TYPE gsea_files gauge\n");
+    fprintf(f, "gsea_files{state=\"total\"} %llu\n", (unsigned long long)m.total);
+    fprintf(f, "gsea_files{state=\"queued\"} %llu\n", (unsigned long long)metrics_waiting(&m));
+    fprintf(f, "gsea_files{state=\"in_flight\"} %llu\n", (unsigned long long)metrics_in_flight(&m));
+    fprintf(f, "gsea_files{state=\"done\"} %llu\n", (unsigned long long)m.done);
+    fprintf(f, "gsea_files{state=\"failed\"} %llu\n", (unsigned long long)m.failed);
+    fprintf(f, "# HELP gsea_threads_active Hilos procesando un archivo\n# TYPE gsea_threads_active gauge\n");
+    fprintf(f, "gsea_threads_active %lld\n", (long long)m.threads);
+    fprintf(f, "# HELP gsea_worker_seconds_total Tiempo de los hilos sobre archivos terminados, en CPU o esperando\n# TYPE gsea_worker_seconds_total counter\n");
+    fprintf(f, "gsea_worker_seconds_total{state=\"cpu\"} %.6f\n", (double)m.cpu_usec / 1e6);
+    fprintf(f, "gsea_worker_seconds_total{state=\"wait\"} %.6f\n", (double)(m.wall_usec > m.cpu_usec ? m.wall_usec - m.cpu_usec : 0) / 1e6);
+
+    fprintf(f, "# HELP gsea_op_bytes_in_total Bytes leidos por operacion\n# TYPE gsea_op_bytes_in_total counter\n");
+    for (int op = OP_NONE + 1; op < METRICS_OPS; ++op)
+        fprintf(f, "gsea_op_bytes_in_total{op=\"%s\"} %llu\n", metrics_op_names[op], (unsigned long long)m.ops[op].bytes_in);
+    fprintf(f, "# HELP gsea_op_bytes_out_total Bytes escritos por operacion\n# TYPE gsea_op_bytes_out_total counter\n");
+    for (int op = OP_NONE + 1; op < METRICS_OPS; ++op)
+        fprintf(f, "gsea_op_bytes_out_total{op=\"%s\"} %llu\n", metrics_op_names[op], (unsigned long long)m.ops[op].bytes_out);
+
+    fprintf(f, "# HELP gsea_op_duration_seconds Duracion de cada operacion sobre un archivo\n# TYPE gsea_op_duration_seconds histogram\n");
+    for (int op = OP_NONE + 1; op < METRICS_OPS; ++op) {
+        const OpTotals *t = &m.ops[op];
+        uint64_t cum = 0;
+        for (int b = 0; b < METRICS_BUCKETS; ++b) {
+            cum += t->bucket[b];
+            fprintf(f, "gsea_op_duration_seconds_bucket{op=\"%s\",le=\"%g\"} %llu\n", metrics_op_names[op],
+                    (double)((uint64_t)1 << (b + 6)) / 1e6, (unsigned long long)cum);
+        }
+        cum += t->bucket[METRICS_BUCKETS];
+        fprintf(f, "gsea_op_duration_seconds_bucket{op=\"%s\",le=\"+Inf\"} %llu\n", metrics_op_names[op], (unsigned long long)cum);
+        fprintf(f, "gsea_op_duration_seconds_sum{op=\"%s\"} %.6f\n", metrics_op_names[op], (double)t->usec_sum / 1e6);
+        fprintf(f, "gsea_op_duration_seconds_count{op=\"%s\"} %llu\n", metrics_op_names[op], (unsigned long long)t->count);
+    }
+}
+
+/* -------------------------------------------------------
+   Background threads
+   ------------------------------------------------------- */
+
+static void *metrics_signal_loop(void *arg) {
+    (void)arg;
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR1);
+    uint64_t last_usec = metrics_t0, last_bytes = 0;
+    for (;;) {
+        int sig;
+        if (sigwait(&set, &sig) != 0) continue;
+        if (atomic_load(&metrics_stopping)) break;
+        metrics_dump(stderr, &last_usec, &last_bytes);
+    }
+    return NULL;
+}
+
+/* one scrape: the request (if any) is read only to answer HTTP clients */
+static void metrics_serve_client(int fd) {
+    char req[512];
+    ssize_t n = 0;
+    struct pollfd p = { fd, POLLIN, 0 };
+    if (poll(&p, 1, 100) > 0) n = read(fd, req, sizeof(req) - 1);
+    int http = n >= 4 && memcmp(req, "GET ", 4) == 0;
+
+    char *text = NULL;
+    size_t len = 0;
+    FILE *f = open_memstream(&text, &len);
+    if (!f) return;
+    if (http) fprintf(f, "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n\r\n");
+    metrics_prometheus(f);
+    fclose(f);
+
+    size_t off = 0;
+    while (off < len) {
+        ssize_t w = write(fd, text + off, len - off);
+        if (w <= 0) break;
+        off += (size_t)w;
+    }
+    free(text);
+}
+
+static void *metrics_socket_loop(void *arg) {
+    (void)arg;
+    while (!atomic_load(&metrics_stopping)) {
+        struct pollfd p = { metrics_sock_fd, POLLIN, 0 };
+        if (poll(&p, 1, METRICS_POLL_MS) <= 0) continue;
+        int c = accept(metrics_sock_fd, NULL, NULL);
+        if (c < 0) continue;
+        metrics_serve_client(c);
+        close(c);
+    }
+    return NULL;
+}
+
+int metrics_start(const char *socket_path) {
+    if (metrics_running) return 0;
+    metrics_t0 = metrics_now_usec();
+    for (int i = 0; i < METRICS_SLOTS; ++i) pthread_mutex_init(&metrics_slots[i].cur_lock, NULL);
+
+    /* SIGUSR1 stays blocked here and in every thread created afterwards;
+       the metrics threads block everything so other signals (SIGINT,
+       SIGTERM) keep going to the threads that expect them */
+    sigset_t set, all, old;
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR1);
+    sigfillset(&all);
+    if (pthread_sigmask(SIG_BLOCK, &set, NULL) != 0) return 1;
+    pthread_sigmask(SIG_BLOCK, &all, &old);
+    if (pthread_create(&metrics_sig_thread, NULL, metrics_signal_loop, NULL) != 0) {
+        perror("[metrics_start] pthread_create");
+        pthread_sigmask(SIG_SETMASK, &old, NULL);
+        return 1;
+    }
+    metrics_running = 1;
+
+    if (socket_path) {
+        metrics_sock_fd = unix_socket_listen(socket_path);
+        if (metrics_sock_fd < 0) {
+            pthread_sigmask(SIG_SETMASK, &old, NULL);
+            metrics_stop();
+            return 1;
+        }
+        metrics_sock_path = strdup(socket_path);
+        if (pthread_create(&metrics_sock_thread, NULL, metrics_socket_loop, NULL) != 0) {
+            perror("[metrics_start] pthread_create");
+            close(metrics_sock_fd);
+            metrics_sock_fd = -1;
+            pthread_sigmask(SIG_SETMASK, &old, NULL);
+            metrics_stop();
+            return 1;
+        }
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    return 0;
+}
+
+void metrics_stop(void) {
+    if (!metrics_running) return;
+    atomic_store(&metrics_stopping, 1);
+    pthread_kill(metrics_sig_thread, SIGUSR1);
+    pthread_join(metrics_sig_thread, NULL);
+    if (metrics_sock_fd >= 0) {
+        pthread_join(metrics_sock_thread, NULL);
+        close(metrics_sock_fd);
+        metrics_sock_fd = -1;
+        if (metrics_sock_path) unlink(metrics_sock_path);
+    }
+    free(metrics_sock_path);
+    metrics_sock_path = NULL;
+    metrics_running = 0;
+}
@@ -0,0 +1,419 @@
+#define _POSIX_C_SOURCE 200809L
+#include "../../include/server.h"
+#include "../../include/executor.h"
+#include "../../include/affinity.h"
+#include "../../include/file.h"
+#include "../../include/metrics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <signal.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/socket.h>
+
+/* =======================================================
+   Daemon mode
+   - the main thread accepts connections and watches SIGINT/SIGTERM
+   - one reader thread per connection parses job lines and queues
+     them (bounded queue: a fast client blocks instead of growing it)
+   - a fixed pool of workers runs process_file_pipeline on each job
+     and writes the answer back on the job's connection (with
+     --durability batch, only after the output's filesystem is synced)
+   - a connection is freed when its reader and all its jobs are done
+   ======================================================= */
+
+#define SERVE_QUEUE_MAX   1024
+#define SERVE_LINE_MAX    8192
+#define SERVE_POLL_MS     250
+
+typedef struct {
+    char *id;
+    FeistelKey fk;
+} ServeKey;
+
+typedef struct {
+    int fd;
+    pthread_mutex_t lock;   /* answers and refs */
+    int refs;               /* reader + queued jobs */
+} ServeConn;
+
+typedef struct ServeJob {
+    struct ServeJob *next;
+    ServeConn *conn;
+    unsigned long seq;
+    OperationType ops[4];
+    char *in_path, *out_path;
+    const FeistelKey *fk;
+} ServeJob;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty, not_full, idle;
+    ServeJob *head, *tail;
+    size_t len;
+    int closing;            /* no more jobs: workers drain and exit */
+    int readers;            /* connections still reading */
+    atomic_int stopping;    /* readers stop taking lines */
+    const CompressOptions *comp;
+    ServeKey *keys;
+    size_t nkeys;
+} ServeState;
+
+/* -------------------------------------------------------
+   Keys (derived once, read-only afterwards)
+   ------------------------------------------------------- */
+
+static int serve_add_key(ServeState *s, const char *id, const char *secret, size_t secret_len) {
+    ServeKey *tmp = realloc(s->keys, (s->nkeys + 1) * sizeof(ServeKey));
+    if (!tmp) return 1;
+    s->keys = tmp;
+    tmp[s->nkeys].id = strdup(id);
+    if (!tmp[s->nkeys].id) return 1;
+    feistel_init(&tmp[s->nkeys].fk, (const unsigned char *)secret, secret_len);
+    s->nkeys++;
+    return 0;
+}
+
+static int serve_load_keys(ServeState *s, const char *path) {
+    size_t len;
+    unsigned char *buf = read_file_complete(path, &len);
+    if (!buf) return 1;
+    char *text = malloc(len + 1);
+    if (!text) { free(buf); return 1; }
+    memcpy(text, buf, len);
+    text[len] = '\0';
+    memset(buf, 0, len);
+    free(buf);
+
+    int rc = 0;
+    char *save = NULL;
+    for (char *line = strtok_r(text, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+        size_t n = strlen(line);
+        if (n > 0 && line[n - 1] == '\r') line[--n] = '\0';
+        if (n == 0 || line[0] == '#') continue;
+        char *colon = strchr(line, ':');
+        if (!colon || colon == line || colon[1] == '\0') {
+            fprintf(stderr, "[serve_unix_socket] %s: linea invalida (se espera id:clave)\n", path);
+            rc = 1;
+            break;
+        }
+        *colon = '\0';
+        if (serve_add_key(s, line, colon + 1, strlen(colon + 1)) != 0) { rc = 1; break; }
+    }
+    memset(text, 0, len);
+    free(text);
+    return rc;
+}
+
+static const FeistelKey *serve_find_key(const ServeState *s, const char *id) {
+    for (size_t i = 0; i < s->nkeys; ++i) {
+        if (strcmp(s->keys[i].id, id) == 0) return &s->keys[i].fk;
+    }
+    return NULL;
+}
+
+/* -------------------------------------------------------
+   Connections
+   ------------------------------------------------------- */
+
+static void serve_conn_unref(ServeConn *c) {
+    pthread_mutex_lock(&c->lock);
+    int left = --c->refs;
+    pthread_mutex_unlock(&c->lock);
+    if (left > 0) return;
+    close(c->fd);
+    pthread_mutex_destroy(&c->lock);
+    free(c);
+}
+
+static void serve_reply(ServeConn *c, const char *fmt, ...) {
+    char line[512];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+    if (n < 0) return;
+    if ((size_t)n >= sizeof(line)) n = sizeof(line) - 1;
+
+    pthread_mutex_lock(&c->lock);
+    size_t off = 0;
+    while (off < (size_t)n) {
+        /* the client may be gone: no SIGPIPE, just drop the answer */
+        ssize_t w = send(c->fd, line + off, (size_t)n - off, MSG_NOSIGNAL);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) break;
+        off += (size_t)w;
+    }
+    pthread_mutex_unlock(&c->lock);
+}
+
+static int serve_needs_key(const OperationType *ops) {
+    for (int i = 0; i < 4; ++i) {
+        if (ops[i] == OP_ENCRYPT || ops[i] == OP_DECRYPT) return 1;
+    }
+    return 0;
+}
+
+/* one request line -> queued job, or an immediate answer */
+static void serve_handle_line(ServeState *s, ServeConn *c, unsigned long seq, char *line) {
+    if (strcmp(line, "PING") == 0) {
+        serve_reply(c, "PONG\n");
+        return;
+    }
+    char *field[5] = { NULL };
+    int nf = 0;
+    char *save = NULL;
+    for (char *f = strtok_r(line, "\t", &save); f && nf < 5; f = strtok_r(NULL, "\t", &save)) field[nf++] = f;
+    if (nf < 3 || nf > 4) {
+        serve_reply(c, "ERR\t%lu\tse espera ops<TAB>entrada<TAB>salida[<TAB>clave]\n", seq);
+        return;
+    }
+
+    ServeJob *job = calloc(1, sizeof(ServeJob));
+    if (!job) { serve_reply(c, "ERR\t%lu\tsin memoria\n", seq); return; }
+    size_t nops = 0;
+    for (int i = 0; i < 4; ++i) job->ops[i] = OP_NONE;
+    if (parse_sequence(field[0], job->ops, &nops) != 0 || nops == 0) {
+        serve_reply(c, "ERR\t%lu\toperaciones invalidas: %s\n", seq, field[0]);
+        free(job);
+        return;
+    }
+    if (serve_needs_key(job->ops)) {
+        const char *id = nf == 4 ? field[3] : "default";
+        job->fk = serve_find_key(s, id);
+        if (!job->fk) {
+            serve_reply(c, "ERR\t%lu\tclave desconocida: %s\n", seq, id);
+            free(job);
+            return;
+        }
+    }
+    job->in_path = strdup(field[1]);
+    job->out_path = strdup(field[2]);
+    if (!job->in_path || !job->out_path) {
+        serve_reply(c, "ERR\t%lu\tsin memoria\n", seq);
+        free(job->in_path); free(job->out_path); free(job);
+        return;
+    }
+    job->conn = c;
+    job->seq = seq;
+
+    pthread_mutex_lock(&c->lock);
+    c->refs++;
+    pthread_mutex_unlock(&c->lock);
+
+    pthread_mutex_lock(&s->lock);
+    while (s->len >= SERVE_QUEUE_MAX) pthread_cond_wait(&s->not_full, &s->lock);
+    if (s->tail) s->tail->next = job;
+    else s->head = job;
+    s->tail = job;
+    s->len++;
+    pthread_cond_signal(&s->not_empty);
+    pthread_mutex_unlock(&s->lock);
+    metrics_file_queued();
+}
+
+typedef struct {
+    ServeState *state;
+    ServeConn *conn;
+} ServeReaderArgs;
+
+static void *serve_reader(void *arg) {
+    ServeReaderArgs *ra = arg;
+    ServeState *s = ra->state;
+    ServeConn *c = ra->conn;
+    free(ra);
+
+    char *buf = malloc(SERVE_LINE_MAX);
+    size_t len = 0;
+    unsigned long seq = 0;
+    while (buf && !atomic_load(&s->stopping)) {
+        struct pollfd p = { c->fd, POLLIN, 0 };
+        int pr = poll(&p, 1, SERVE_POLL_MS);
+        if (pr < 0 && errno != EINTR) break;
+        if (pr <= 0) continue;
+        ssize_t r = read(c->fd, buf + len, SERVE_LINE_MAX - len);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) break;
+        len += (size_t)r;
+
+        size_t start = 0;
+        for (size_t i = 0; i < len; ++i) {
+            if (buf[i] != '\n') continue;
+            buf[i] = '\0';
+            if (i > start && buf[i - 1] == '\r') buf[i - 1] = '\0';
+            if (buf[start] != '\0') serve_handle_line(s, c, ++seq, buf + start);
+            start = i + 1;
+        }
+        memmove(buf, buf + start, len - start);
+        len -= start;
+        if (len == SERVE_LINE_MAX) {
+            serve_reply(c, "ERR\t%lu\tlinea demasiado larga\n", ++seq);
+            break;
+        }
+    }
+    free(buf);
+
+    pthread_mutex_lock(&s->lock);
+    s->readers--;
+    pthread_cond_broadcast(&s->idle);
+    pthread_mutex_unlock(&s->lock);
+    serve_conn_unref(c);
+    return NULL;
+}
+
+/* -------------------------------------------------------
+   Worker pool
+   ------------------------------------------------------- */
+
+static void *serve_worker(void *arg) {
+    ServeState *s = arg;
+    for (;;) {
+        pthread_mutex_lock(&s->lock);
+        while (!s->head && !s->closing) pthread_cond_wait(&s->not_empty, &s->lock);
+        ServeJob *job = s->head;
+        if (!job) { pthread_mutex_unlock(&s->lock); break; }
+        s->head = job->next;
+        if (!s->head) s->tail = NULL;
+        s->len--;
+        pthread_cond_signal(&s->not_full);
+        pthread_mutex_unlock(&s->lock);
+
+        int result = 1;
+        ThreadArgs *args = malloc(sizeof(ThreadArgs));
+        if (args) {
+            // process_file_pipeline libera args y las rutas
+            args->input_file_path = job->in_path;
+            args->output_file_path = job->out_path;
+            args->key = NULL;
+            args->fkey = job->fk;
+            args->comp = s->comp;
+            args->limiter = NULL;
+            args->result = &result;
+            for (int i = 0; i < 4; ++i) args->sequence[i] = job->ops[i];
+            process_file_pipeline(args);
+        } else {
+            free(job->in_path);
+            free(job->out_path);
+        }
+        // --durability batch: el OK promete que la salida ya está en disco;
+        // los trabajos que terminan juntos comparten el mismo syncfs
+        if (result == 0 && io_output_flush() != 0) result = 1;
+
+        if (result == 0) serve_reply(job->conn, "OK\t%lu\n", job->seq);
+        else serve_reply(job->conn, "ERR\t%lu\tfallo el procesamiento (ver stderr del servicio)\n", job->seq);
+        serve_conn_unref(job->conn);
+        free(job);
+    }
+    return NULL;
+}
+
+/* -------------------------------------------------------
+   Accept loop
+   ------------------------------------------------------- */
+
+static int serve_should_stop(const sigset_t *stop_set) {
+    struct timespec zero = { 0, 0 };
+    return sigtimedwait(stop_set, NULL, &zero) > 0;
+}
+
+static void serve_accept(ServeState *s, int lfd) {
+    int fd = accept(lfd, NULL, NULL);
+    if (fd < 0) return;
+    ServeConn *c = calloc(1, sizeof(ServeConn));
+    ServeReaderArgs *ra = malloc(sizeof(ServeReaderArgs));
+    if (!c || !ra) { free(c); free(ra); close(fd); return; }
+    c->fd = fd;
+    c->refs = 1;
+    pthread_mutex_init(&c->lock, NULL);
+    ra->state = s;
+    ra->conn = c;
+
+    pthread_mutex_lock(&s->lock);
+    s->readers++;
+    pthread_mutex_unlock(&s->lock);
+
+    pthread_t t;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&t, &attr, serve_reader, ra) != 0) {
+        perror("[serve_unix_socket] pthread_create");
+        pthread_mutex_lock(&s->lock);
+        s->readers--;
+        pthread_mutex_unlock(&s->lock);
+        free(ra);
+        serve_conn_unref(c);
+    }
+    pthread_attr_destroy(&attr);
+}
+
+int serve_unix_socket(const char *socket_path, int max_threads, const char *default_key, const char *keys_path, const CompressOptions *comp) {
+    ServeState s;
+    memset(&s, 0, sizeof(s));
+    s.comp = comp;
+    if (default_key && serve_add_key(&s, "default", default_key, strlen(default_key)) != 0) return 1;
+    if (keys_path && serve_load_keys(&s, keys_path) != 0) goto serve_free_keys;
+
+    // SIGINT / SIGTERM se atienden en el bucle principal (los hilos los heredan bloqueados)
+    sigset_t stop_set;
+    sigemptyset(&stop_set);
+    sigaddset(&stop_set, SIGINT);
+    sigaddset(&stop_set, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop_set, NULL);
+
+    int lfd = unix_socket_listen(socket_path);
+    if (lfd < 0) goto serve_free_keys;
+
+    if (max_threads <= 0) {
+        max_threads = affinity_default_threads();
+    }
+    pthread_mutex_init(&s.lock, NULL);
+    pthread_cond_init(&s.not_empty, NULL);
+    pthread_cond_init(&s.not_full, NULL);
+    pthread_cond_init(&s.idle, NULL);
+    pthread_t *workers = calloc((size_t)max_threads, sizeof(pthread_t));
+    int nworkers = 0;
+    while (workers && nworkers < max_threads && pthread_create(&workers[nworkers], NULL, serve_worker, &s) == 0) nworkers++;
+    if (nworkers == 0) {
+        perror("[serve_unix_socket] pthread_create");
+        free(workers);
+        close(lfd);
+        unlink(socket_path);
+        goto serve_free_keys;
+    }
+    fprintf(stderr, "[serve_unix_socket] Escuchando en %s (%d hilos, %zu claves)\n", socket_path, nworkers, s.nkeys);
+
+    while (!serve_should_stop(&stop_set)) {
+        struct pollfd p = { lfd, POLLIN, 0 };
+        if (poll(&p, 1, SERVE_POLL_MS) > 0) serve_accept(&s, lfd);
+    }
+    fprintf(stderr, "[serve_unix_socket] Terminando: se completan los trabajos pendientes\n");
+    close(lfd);
+    unlink(socket_path);
+
+    // 1) los lectores dejan de aceptar trabajos; 2) los workers vacían la cola
+    pthread_mutex_lock(&s.lock);
+    atomic_store(&s.stopping, 1);
+    while (s.readers > 0) pthread_cond_wait(&s.idle, &s.lock);
+    s.closing = 1;
+    pthread_cond_broadcast(&s.not_empty);
+    pthread_mutex_unlock(&s.lock);
+    for (int i = 0; i < nworkers; ++i) pthread_join(workers[i], NULL);
+    free(workers);
+
+    for (size_t i = 0; i < s.nkeys; ++i) free(s.keys[i].id);
+    free(s.keys);
+    return 0;
+
+serve_free_keys:
+    for (size_t i = 0; i < s.nkeys; ++i) free(s.keys[i].id);
+    free(s.keys);
+    return 1;
+}
@@ -0,0 +1,181 @@
+#define _POSIX_C_SOURCE 200809L
+#include "../../include/trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+
+/* =======================================================
+   Trace events
+   - every thread appends B/E events to its own buffer, no locks
+     on the hot path (the registry lock is taken once per thread)
+   - worker threads live for one file only, so instead of one row
+     per thread they borrow a "lane" (row) and give it back when
+     done: rows show the -t concurrency slots
+   - lane 0 is the main thread (directory walk, limiter waits)
+   ======================================================= */
+
+#define TRACE_MAX_LANES 1024
+
+typedef struct {
+    const char *name;
+    char *detail;
+    uint64_t ts_ns;
+    char ph;          /* 'B' or 'E' */
+} TraceEvent;
+
+typedef struct TraceBuf {
+    struct TraceBuf *next;
+    int lane;
+    TraceEvent *ev;
+    size_t len, cap;
+} TraceBuf;
+
+static atomic_int trace_on;
+static char *trace_path;
+static uint64_t trace_t0;
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static TraceBuf *trace_bufs;
+static unsigned char trace_lanes[TRACE_MAX_LANES];
+static int trace_lane_max;
+static _Thread_local TraceBuf *trace_self;
+
+static uint64_t trace_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static TraceBuf *trace_buf(void) {
+    if (trace_self) return trace_self;
+    TraceBuf *b = calloc(1, sizeof(TraceBuf));
+    if (!b) return NULL;
+    pthread_mutex_lock(&trace_lock);
+    int lane = 1;
+    while (lane < TRACE_MAX_LANES - 1 && trace_lanes[lane]) lane++;
+    trace_lanes[lane] = 1;   /* the last lane is shared if they run out */
+    if (lane > trace_lane_max) trace_lane_max = lane;
+    b->lane = lane;
+    b->next = trace_bufs;
+    trace_bufs = b;
+    pthread_mutex_unlock(&trace_lock);
+    trace_self = b;
+    return b;
+}
+
+static void trace_add(char ph, const char *name, const char *detail) {
+    TraceBuf *b = trace_buf();
+    if (!b) return;
+    if (b->len == b->cap) {
+        size_t nc = b->cap ? b->cap * 2 : 256;
+        TraceEvent *tmp = realloc(b->ev, nc * sizeof(TraceEvent));
+        if (!tmp) return;
+        b->ev = tmp;
+        b->cap = nc;
+    }
+    TraceEvent *e = &b->ev[b->len++];
+    e->name = name;
+    e->detail = detail ? strdup(detail) : NULL;
+    e->ph = ph;
+    e->ts_ns = trace_now_ns();
+}
+
+void trace_begin(const char *name, const char *detail) {
+    if (!atomic_load_explicit(&trace_on, memory_order_relaxed)) return;
+    trace_add('B', name, detail);
+}
+
+void trace_end(void) {
+    if (!atomic_load_explicit(&trace_on, memory_order_relaxed)) return;
+    trace_add('E', NULL, NULL);
+}
+
+void trace_thread_done(void) {
+    TraceBuf *b = trace_self;
+    if (!b || b->lane == 0) return;
+    pthread_mutex_lock(&trace_lock);
+    trace_lanes[b->lane] = 0;
+    pthread_mutex_unlock(&trace_lock);
+    trace_self = NULL;
+}
+
+int trace_start(const char *path) {
+    trace_path = strdup(path);
+    if (!trace_path) return 1;
+    TraceBuf *b = calloc(1, sizeof(TraceBuf));
+    if (!b) { free(trace_path); trace_path = NULL; return 1; }
+    trace_lanes[0] = 1;
+    b->lane = 0;
+    trace_bufs = b;
+    trace_self = b;
+    trace_t0 = trace_now_ns();
+    atomic_store(&trace_on, 1);
+    return 0;
+}
+
+static void trace_write_string(FILE *f, const char *s) {
+    fputc('"', f);
+    for (; *s; ++s) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') fprintf(f, "\\%c", c);
+        else if (c < 0x20) fprintf(f, "\\u%04x", c);
+        else fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+int trace_stop(void) {
+    if (!atomic_load(&trace_on)) return 0;
+    /* every worker has been joined by now */
+    atomic_store(&trace_on, 0);
+
+    int rc = 0;
+    FILE *f = fopen(trace_path, "w");
+    if (!f) { perror("[trace_stop] fopen"); rc = 1; }
+    if (f) {
+        fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        fprintf(f, "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"gsea\"}}");
+        for (int lane = 0; lane <= trace_lane_max; ++lane) {
+            fprintf(f, ",\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", lane);
+            if (lane == 0) fprintf(f, "\"main\"}}");
+            else fprintf(f, "\"worker %d\"}}", lane);
+        }
+    }
+    TraceBuf *b = trace_bufs;
+    while (b) {
+        for (size_t i = 0; f && i < b->len; ++i) {
+            const TraceEvent *e = &b->ev[i];
+            double ts = (double)(e->ts_ns - trace_t0) / 1e3;
+            fprintf(f, ",\n{\"ph\":\"%c\",\"pid\":1,\"tid\":%d,\"ts\":%.3f", e->ph, b->lane, ts);
+            if (e->name) {
+                fprintf(f, ",\"name\":");
+                trace_write_string(f, e->name);
+            }
+            if (e->detail) {
+                fprintf(f, ",\"args\":{\"file\":");
+                trace_write_string(f, e->detail);
+                fputc('}', f);
+            }
+            fputc('}', f);
+        }
+        for (size_t i = 0; i < b->len; ++i) free(b->ev[i].detail);
+        TraceBuf *next = b->next;
+        free(b->ev);
+        free(b);
+        b = next;
+    }
+    trace_bufs = NULL;
+    trace_self = NULL;
+    if (f) {
+        fprintf(f, "\n]}\n");
+        if (fclose(f) != 0) { perror("[trace_stop] fclose"); rc = 1; }
+        else fprintf(stderr, "[trace_stop] Traza escrita en %s\n", trace_path);
+    }
+    free(trace_path);
+    trace_path = NULL;
+    return rc;
+}
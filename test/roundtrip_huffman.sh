@@ -0,0 +1,38 @@
+#!/bin/sh
+# Regresión: Huffman sobre una entrada que ya es un contenedor .gsz.
+# La capa interna solo se deshace si la cabecera lo marca (-m ch); con
+# -a huffman -m c o -m h sobre un .gsz, -m d debe devolver el .gsz tal cual.
+set -e
+
+BIN=${BIN:-./bin/gsea}
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+# entrada comprimible de ~400 KB a partir de las fuentes
+cat src/algorithms/*.c src/pipeline/*.c > "$TMP/x"
+cat "$TMP/x" "$TMP/x" > "$TMP/plain"
+"$BIN" -i "$TMP/plain" -o "$TMP/plain.gsz" -m c > /dev/null
+
+check() {
+    if cmp -s "$1" "$2"; then
+        echo "ok   $3"
+    else
+        echo "FAIL $3"
+        exit 1
+    fi
+}
+
+"$BIN" -i "$TMP/plain.gsz" -o "$TMP/a.gsz" -m c -a huffman > /dev/null
+"$BIN" -i "$TMP/a.gsz" -o "$TMP/a.out" -m d > /dev/null
+check "$TMP/plain.gsz" "$TMP/a.out" "-a huffman -m c sobre un .gsz"
+
+"$BIN" -i "$TMP/plain.gsz" -o "$TMP/h.gsz" -m h > /dev/null
+"$BIN" -i "$TMP/h.gsz" -o "$TMP/h.out" -m d > /dev/null
+check "$TMP/plain.gsz" "$TMP/h.out" "-m h sobre un .gsz"
+
+"$BIN" -i "$TMP/plain" -o "$TMP/ch.gsz" -m ch > /dev/null
+"$BIN" -i "$TMP/ch.gsz" -o "$TMP/ch.out" -m d > /dev/null
+check "$TMP/plain" "$TMP/ch.out" "-m ch (dos capas)"
+
+"$BIN" -i - -o - -m h < "$TMP/plain.gsz" | "$BIN" -i - -o - -m d > "$TMP/s.out"
+check "$TMP/plain.gsz" "$TMP/s.out" "-m h sobre un .gsz (streaming)"